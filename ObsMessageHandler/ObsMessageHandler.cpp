@@ -7,33 +7,21 @@
 //
 
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <clocale>
+#include <climits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
 #include "ObsMessageHandler.hpp"
 #include "ObsMessageHandlerPriv.hpp"
-
-struct Position {
-    int x = -5;
-    int y = -5;
-    int alignment = -5;
-};
-
-struct Scale {
-    double x = -5;
-    double y = -5;
-};
-
-struct Crop {
-    int top = -5;
-    int bottom = -5;
-    int left = -5;
-    int right = -5;
-};
-
-struct Bounds {
-    std::string type = "NULL";
-    int alignment = -5;
-    int x = -5;
-    int y = -5;
-};
+#include "../websocketmask.hpp"
 
 /* -------------------------------------------------------  Base64 encoding stuff --------------------------------------------------------------------------------------------- */
 
@@ -50,740 +38,3968 @@ static const char reverse_table[128] = {
    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 64, 64, 64, 64, 64
 };
 
-std::string base64_encode(const std::string &bindata)
+//whole 3 byte groups, returns how many input bytes were used
+static std::size_t encodeGroups(const unsigned char* _in, std::size_t _size, char* _out)
 {
-   using std::string;
-   using std::numeric_limits;
-
-   if (bindata.size() > (numeric_limits<string::size_type>::max() / 4u) * 3u) {
-      throw std::length_error("Converting too large a string to base64.");
-   }
-
-   const std::size_t binlen = bindata.size();
-   // Use = signs so the end is properly padded.
-   string retval((((binlen + 2) / 3) * 4), '=');
-   std::size_t outpos = 0;
-   int bits_collected = 0;
-   unsigned int accumulator = 0;
-   const string::const_iterator binend = bindata.end();
-
-   for (string::const_iterator i = bindata.begin(); i != binend; ++i) {
-      accumulator = (accumulator << 8) | (*i & 0xffu);
-      bits_collected += 8;
-      while (bits_collected >= 6) {
-         bits_collected -= 6;
-         retval[outpos++] = b64_table[(accumulator >> bits_collected) & 0x3fu];
-      }
-   }
-   if (bits_collected > 0) { // Any trailing bits that are missing.
-      assert(bits_collected < 6);
-      accumulator <<= 6 - bits_collected;
-      retval[outpos++] = b64_table[accumulator & 0x3fu];
-   }
-   assert(outpos >= (retval.size() - 2));
-   assert(outpos <= retval.size());
-   return retval;
+    const std::size_t groups = _size / 3;
+    for(std::size_t i = 0; i < groups; i++, _in += 3, _out += 4)
+    {
+        const uint32_t group = (uint32_t(_in[0]) << 16) | (uint32_t(_in[1]) << 8) | _in[2];
+        _out[0] = b64_table[group >> 18];
+        _out[1] = b64_table[(group >> 12) & 0x3f];
+        _out[2] = b64_table[(group >> 6) & 0x3f];
+        _out[3] = b64_table[group & 0x3f];
+    }
+    
+    return groups * 3;
 }
 
-std::string base64_decode(const std::string &ascdata)
+//the last 1 or 2 bytes, _out already holds the padding
+static void encodeTail(const unsigned char* _in, std::size_t _size, char* _out)
 {
-   using std::string;
-   string retval;
-   const string::const_iterator last = ascdata.end();
-   int bits_collected = 0;
-   unsigned int accumulator = 0;
-
-   for (string::const_iterator i = ascdata.begin(); i != last; ++i) {
-      const int c = *i;
-      if (std::isspace(c) || c == '=') {
-         // Skip whitespace and padding. Be liberal in what you accept.
-         continue;
-      }
-      if ((c > 127) || (c < 0) || (reverse_table[c] > 63)) {
-         throw std::invalid_argument("This contains characters not legal in a base64 encoded string.");
-      }
-      accumulator = (accumulator << 6) | reverse_table[c];
-      bits_collected += 6;
-      if (bits_collected >= 8) {
-         bits_collected -= 8;
-         retval += static_cast<char>((accumulator >> bits_collected) & 0xffu);
-      }
-   }
-   return retval;
+    if(_size == 0) return;
+    
+    const uint32_t group = (uint32_t(_in[0]) << 16) | (_size > 1 ? uint32_t(_in[1]) << 8 : 0);
+    _out[0] = b64_table[group >> 18];
+    _out[1] = b64_table[(group >> 12) & 0x3f];
+    if(_size > 1) _out[2] = b64_table[(group >> 6) & 0x3f];
 }
 
-
-/* -------------------------------------------------------------- hash 256 encoding stuff ------------------------------------------------------------------------------------------------   */
-
-bool computeHash(const std::string& unhashed, std::string& hashed)
+//value of every character, 0xff for anything that isn't in the alphabet (padding and whitespace included)
+static const std::array<uint8_t, 256> decode_table = []
 {
-    bool success = false;
-
-    EVP_MD_CTX* context = EVP_MD_CTX_new();
-
-    if(context != NULL)
+    std::array<uint8_t, 256> table;
+    table.fill(0xff);
+    for(uint8_t i = 0; i < 64; i++) table[static_cast<unsigned char>(b64_table[i])] = i;
+    return table;
+}();
+
+//whole 4 character groups up to the first one with padding, whitespace or garbage in it
+static void decodeGroups(const unsigned char* _in, std::size_t _size, uint8_t* _out, std::size_t& _read, std::size_t& _written)
+{
+    std::size_t read = _read, written = _written;
+    
+    for(; read + 4 <= _size; read += 4, written += 3)
     {
-        if(EVP_DigestInit_ex(context, EVP_sha256(), NULL))
-        {
-            if(EVP_DigestUpdate(context, unhashed.c_str(), unhashed.length()))
-            {
-                unsigned char hash[EVP_MAX_MD_SIZE];
-                unsigned int lengthOfHash = 0;
+        const uint32_t a = decode_table[_in[read]], b = decode_table[_in[read + 1]], c = decode_table[_in[read + 2]], d = decode_table[_in[read + 3]];
+        if((a | b | c | d) > 63) break;
+        
+        const uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+        _out[written] = static_cast<uint8_t>(group >> 16);
+        _out[written + 1] = static_cast<uint8_t>(group >> 8);
+        _out[written + 2] = static_cast<uint8_t>(group);
+    }
+    
+    _read = read;
+    _written = written;
+}
 
-                if(EVP_DigestFinal_ex(context, hash, &lengthOfHash))
-                {
-                    std::stringstream ss;
-                    for(unsigned int i = 0; i < lengthOfHash; ++i)
-                    {
-                        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-                    }
-
-                    hashed = ss.str();
-                    success = true;
-                }
-            }
-        }
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define OBS_BASE64_SIMD 1
 
-        EVP_MD_CTX_free(context);
-    }
+//kernels after Muła and Lemire. Built for SSSE3 and AVX2 regardless of the compiler flags and picked at runtime,
+//each one handles whole blocks and leaves the rest to the scalar code
 
-    return success;
+__attribute__((target("ssse3")))
+static inline __m128i encodeIndices(__m128i _in)
+{
+    //every 32 bit lane holds 3 input bytes as 4 six bit indices after this
+    _in = _mm_shuffle_epi8(_in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m128i high = _mm_mulhi_epu16(_mm_and_si128(_in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    const __m128i low = _mm_mullo_epi16(_mm_and_si128(_in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(high, low);
 }
 
-ObsMessageHandler::ObsMessageHandler(){
+__attribute__((target("ssse3")))
+static inline __m128i encodeCharacters(__m128i _indices)
+{
+    //0..25 'A', 26..51 'a', 52..61 '0', then '+' and '/': one offset per range, picked with a shuffle
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    __m128i range = _mm_subs_epu8(_indices, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), _indices), _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), _indices);
 }
 
-ObsMessageHandler::~ObsMessageHandler(){
-    ws.close(websocket::close_code::normal);
-    recieveThread.detach();
+__attribute__((target("ssse3")))
+static std::size_t encodeSsse3(const unsigned char* _in, std::size_t _size, char* _out)
+{
+    //12 bytes per block, the load reads 16
+    std::size_t read = 0;
+    for(; read + 16 <= _size; read += 12, _out += 16)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + read));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(_out), encodeCharacters(encodeIndices(in)));
+    }
+    
+    return read;
 }
 
-bool ObsMessageHandler::connect(std::string& _host, std::string& _port)
+__attribute__((target("avx2")))
+static std::size_t encodeAvx2(const unsigned char* _in, std::size_t _size, char* _out)
 {
-    try
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                             'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    
+    //24 bytes per block, 12 in each lane. The second load reads up to byte 28
+    std::size_t read = 0;
+    for(; read + 28 <= _size; read += 24, _out += 32)
     {
-        auto const results = resolver.resolve(_host, _port);
-        net::connect(ws.next_layer(), results.begin(), results.end());
-        
-        ws.set_option(websocket::stream_base::decorator(
-        [](websocket::request_type& req)
-        {
-            req.set(http::field::user_agent,
-                std::string(BOOST_BEAST_VERSION_STRING) +
-                    " websocket-client-coro");
-        }));
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + read));
+        const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + read + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
         
-        ws.handshake(_host, "/");
+        in = _mm256_shuffle_epi8(in, shuffle);
+        const __m256i highBits = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        const __m256i lowBits = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(highBits, lowBits);
         
-    }
-    catch(std::exception const& e)
-    {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return EXIT_FAILURE;
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out), _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices));
     }
     
-    return true;
+    return read;
 }
 
-void ObsMessageHandler::r_GetVersion()
+//both decoders stop at the first block with anything but the 64 alphabet characters in it, and write 4 or 8
+//bytes past the decoded ones
+__attribute__((target("ssse3")))
+static void decodeSsse3(const unsigned char* _in, std::size_t _size, uint8_t* _out, std::size_t& _read, std::size_t& _written)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETVERSION);
-    root["request-type"] = "GetVersion";
+    const __m128i lowLookup = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i highLookup = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    std::size_t read = _read, written = _written;
+    for(; read + 16 <= _size; read += 16, written += 12)
+    {
+        const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_in + read));
+        const __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+        const __m128i lowNibbles = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+        
+        const __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lowLookup, lowNibbles), _mm_shuffle_epi8(highLookup, highNibbles));
+        if(_mm_movemask_epi8(_mm_cmpgt_epi8(invalid, _mm_setzero_si128())) != 0) break;
+        
+        const __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+        const __m128i values = _mm_add_epi8(in, _mm_shuffle_epi8(roll, _mm_add_epi8(slash, highNibbles)));
+        
+        const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        const __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(_out + written), _mm_shuffle_epi8(groups, pack));
+    }
     
-    ws.write(net::buffer(json_file));
+    _read = read;
+    _written = written;
 }
 
-void ObsMessageHandler::r_GetAuthRequired()
+__attribute__((target("avx2")))
+static void decodeAvx2(const unsigned char* _in, std::size_t _size, uint8_t* _out, std::size_t& _read, std::size_t& _written)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETAUTHREQUIRED);
-    root["request-type"] = "GetAuthRequired";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    const __m256i lowLookup = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+                                               0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i highLookup = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                                0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                          0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    
+    std::size_t read = _read, written = _written;
+    for(; read + 32 <= _size; read += 32, written += 24)
+    {
+        const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_in + read));
+        const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), _mm256_set1_epi8(0x0f));
+        const __m256i lowNibbles = _mm256_and_si256(in, _mm256_set1_epi8(0x0f));
+        
+        const __m256i invalid = _mm256_and_si256(_mm256_shuffle_epi8(lowLookup, lowNibbles), _mm256_shuffle_epi8(highLookup, highNibbles));
+        if(_mm256_movemask_epi8(_mm256_cmpgt_epi8(invalid, _mm256_setzero_si256())) != 0) break;
+        
+        const __m256i slash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+        const __m256i values = _mm256_add_epi8(in, _mm256_shuffle_epi8(roll, _mm256_add_epi8(slash, highNibbles)));
+        
+        const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        const __m256i groups = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(groups, pack), lanes);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(_out + written), packed);
+    }
     
-    ws.write(net::buffer(json_file));
+    _read = read;
+    _written = written;
 }
 
-void ObsMessageHandler::r_Authenticate(std::string& _challenge, std::string& _salt, std::string& _password)
+#endif
+
+typedef std::size_t (*EncodeKernel)(const unsigned char*, std::size_t, char*);
+typedef void (*DecodeKernel)(const unsigned char*, std::size_t, uint8_t*, std::size_t&, std::size_t&);
+
+struct Base64Kernels
 {
-    //untested
-    
-    std::string secret_string = _password + _salt, secret_hash;
-    computeHash(secret_string, secret_hash);
-    std::string secret = base64_encode(secret_hash);
-    std::string auth_response_string = secret + _challenge, auth_response_hash;
-    computeHash(auth_response_string, auth_response_hash);
-    std::string auth_response = base64_encode(auth_response_hash);
-    
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(AUTHENTICATE);
-    root["request-type"] = "Authenticate";
-    root["auth"] = auth_response;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
-    
-}
+    EncodeKernel encode = encodeGroups;
+    DecodeKernel decode = decodeGroups;
+};
 
-void ObsMessageHandler::r_SetHeartbeat(bool _enable)
+static const Base64Kernels& base64Kernels()
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(SETHEARTBEAT);
-    root["request-type"] = "SetHeartbeat";
-    root["enable"] = _enable;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    static const Base64Kernels kernels = []
+    {
+        Base64Kernels chosen;
+#if defined(OBS_BASE64_SIMD)
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2"))
+        {
+            chosen.encode = encodeAvx2;
+            chosen.decode = decodeAvx2;
+        }
+        else if(__builtin_cpu_supports("ssse3"))
+        {
+            chosen.encode = encodeSsse3;
+            chosen.decode = decodeSsse3;
+        }
+#endif
+        return chosen;
+    }();
     
-    ws.write(net::buffer(json_file));
+    return kernels;
 }
 
-void ObsMessageHandler::r_SetFilenameFormatting(std::string& _format)
+std::string base64_encode(const std::string &bindata)
 {
-    Json::Value root;
+    if(bindata.size() > (std::numeric_limits<std::string::size_type>::max() / 4u) * 3u)
+    {
+        throw std::length_error("Converting too large a string to base64.");
+    }
     
-    root["message-id"] = std::to_string(SETFILENAMEFORMATTING);
-    root["request-type"] = "SetFilenameFormatting";
-    root["filename-formatting"] = _format;
+    //sized once, the = signs are already in place for the padding
+    const std::size_t binlen = bindata.size();
+    std::string retval(((binlen + 2) / 3) * 4, '=');
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(bindata.data());
+    char* out = &retval[0];
     
-    ws.write(net::buffer(json_file));
+    std::size_t read = base64Kernels().encode(in, binlen, out);
+    read += encodeGroups(in + read, binlen - read, out + read / 3 * 4);
+    encodeTail(in + read, binlen - read, out + read / 3 * 4);
+    
+    return retval;
 }
 
-void ObsMessageHandler::r_GetFilenameFormatting()
+std::string base64_decode(const std::string &ascdata)
 {
-    Json::Value root;
+    //room for every character being data plus what the vector stores write past the end, trimmed at the end
+    const std::size_t asclen = ascdata.size();
+    std::string retval(asclen / 4 * 3 + 3 + 32, '\0');
     
-    root["message-id"] = std::to_string(GETFILENAMEFORMATTING);
-    root["request-type"] = "GetFilenameFormatting";
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(ascdata.data());
+    uint8_t* out = reinterpret_cast<uint8_t*>(&retval[0]);
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
-}
-
-void ObsMessageHandler::r_GetStats()
-{
-    Json::Value root;
+    std::size_t read = 0, written = 0;
+    base64Kernels().decode(in, asclen, out, read, written);
+    decodeGroups(in, asclen, out, read, written);
     
-    root["message-id"] = std::to_string(GETSTATS);
-    root["request-type"] = "GetStats";
+    //padding, whitespace and anything malformed from here on
+    int bits_collected = 0;
+    unsigned int accumulator = 0;
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    for(; read < asclen; read++)
+    {
+        const int c = in[read];
+        if(std::isspace(c) || c == '=')
+        {
+            // Skip whitespace and padding. Be liberal in what you accept.
+            continue;
+        }
+        if(c > 127 || reverse_table[c] > 63)
+        {
+            throw std::invalid_argument("This contains characters not legal in a base64 encoded string.");
+        }
+        accumulator = (accumulator << 6) | reverse_table[c];
+        bits_collected += 6;
+        if(bits_collected >= 8)
+        {
+            bits_collected -= 8;
+            out[written++] = static_cast<uint8_t>((accumulator >> bits_collected) & 0xffu);
+        }
+    }
     
-    ws.write(net::buffer(json_file));
+    retval.resize(written);
+    return retval;
 }
 
-void ObsMessageHandler::r_BroadcastCustomMessage(std::string _realm, Json::Value& _object)
+
+/* -------------------------------------------------------------- hash 256 encoding stuff ------------------------------------------------------------------------------------------------   */
+
+//one context per thread, EVP_DigestInit_ex resets it for every hash instead of a new allocation each time
+bool computeHash(const char* _data, std::size_t _size, unsigned char* _digest)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(BROADCASTCUSTOMMESSAGE);
-    root["request-type"] = "BroadcastCustomMessage";
-    root["realm"] = _realm;
-    root["data"] = _object;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    struct Context
+    {
+        EVP_MD_CTX* context = EVP_MD_CTX_new();
+        ~Context() { EVP_MD_CTX_free(context); }
+    };
+    static thread_local Context hashContext;
+    
+    unsigned int lengthOfHash = 0;
+    return hashContext.context != NULL &&
+        EVP_DigestInit_ex(hashContext.context, EVP_sha256(), NULL) &&
+        EVP_DigestUpdate(hashContext.context, _data, _size) &&
+        EVP_DigestFinal_ex(hashContext.context, _digest, &lengthOfHash);
 }
 
-void ObsMessageHandler::r_GetVideoInfo()
+//base64 of a raw digest: ten full groups and a padded one, always 44 characters
+static std::string encodeDigest(const unsigned char* _digest)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETVIDEOINFO);
-    root["request-type"] = "GetVideoInfo";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    std::string encoded(44, '=');
+    encodeGroups(_digest, 30, &encoded[0]);
+    encodeTail(_digest + 30, 2, &encoded[40]);
+    return encoded;
 }
 
-void ObsMessageHandler::r_OpenProjector(std::string _type = "NULL", int _monitor = -5, int _x = -5, int _y = -5, int _width = -5, int _height = -5, std::string _name = "NULL")
+//the secret only changes with the password or the salt OBS hands out, a reconnect storm across many
+//connections to the same OBS derives it once
+//base64(sha256(password + salt)), only the handler's own password is cached and only by salt, so no
+//plaintext lands in a cache and a password change drops it along with the old secrets
+std::string ObsMessageHandler::authSecret(const std::string& _password, const std::string& _salt)
 {
-    //not tested
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(OPENPROJECTOR);
-    root["request-type"] = "OpenProjector";
-    
-    std::string geometry = base64_encode(std::to_string(_x) + "," + std::to_string(_y) + "," + std::to_string(_width) + "," + std::to_string(_height));
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if(_password == password)
+        {
+            for(const std::pair<std::string, std::string>& cached : authSecrets)
+            {
+                if(cached.first == _salt) return cached.second;
+            }
+        }
+    }
     
-    if(_type != "NULL") root["type"] = _type;
-    if(_monitor != -5) root["monitor"] = _monitor;
-    if(_x != -5 || _y != -5 || _width != -5 || _height != -5) root["geometry"] = geometry;
-    if(_name != "NULL") root["name"] = _name;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    const std::string input = _password + _salt;
+    if(!computeHash(input.data(), input.size(), digest)) return std::string();
+    std::string secret = encodeDigest(digest);
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if(_password != password) return secret;
     
-    ws.write(net::buffer(json_file));
+    //OBS keeps one salt per password, a few cover reconnecting to a restarted or different instance
+    if(authSecrets.size() >= maxAuthSecrets) authSecrets.erase(authSecrets.begin());
+    authSecrets.emplace_back(_salt, secret);
+    return secret;
 }
 
-void ObsMessageHandler::r_ListOutputs()
+//base64(sha256(base64(sha256(password + salt)) + challenge)), the raw digests are encoded and not their hex
+std::string ObsMessageHandler::authResponse(const std::string& _password, const std::string& _salt, const std::string& _challenge)
 {
-    Json::Value root;
+    std::string input = authSecret(_password, _salt);
+    if(input.empty()) return input;
+    input.append(_challenge);
     
-    root["message-id"] = std::to_string(LISTOUTPUTS);
-    root["request-type"] = "ListOutputs";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    if(!computeHash(input.data(), input.size(), digest)) return std::string();
+    return encodeDigest(digest);
 }
 
-void ObsMessageHandler::r_GetOutputInfo(std::string& _outputName)
+/* -------------------------------------------------------------- event types ------------------------------------------------------------------------------------------------------------   */
+
+ObsEventType eventTypeFromString(const char* _data, std::size_t _size)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETOUTPUTINFO);
-    root["request-type"] = "GetOutputInfo";
-    root["outputName"] = _outputName;
+    ObsEventType type = ObsEventType::Unknown;
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    switch(hashUpdateType(_data, _size))
+    {
+#define OBS_EVENT_CASE(name) case hashUpdateType(#name, sizeof(#name) - 1): type = ObsEventType::name; break;
+        OBS_EVENT_TYPES(OBS_EVENT_CASE)
+#undef OBS_EVENT_CASE
+        default: return ObsEventType::Unknown;
+    }
     
-    ws.write(net::buffer(json_file));
+    //a hit only means the hash matched, one compare rules out unknown strings that collide
+    const char* name = eventTypeName(type);
+    if(std::strlen(name) != _size || std::memcmp(name, _data, _size) != 0) return ObsEventType::Unknown;
+    return type;
 }
 
-void ObsMessageHandler::r_StartOutput(std::string& _outputName)
+const char* eventTypeName(ObsEventType _type)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(STARTOUTPUT);
-    root["request-type"] = "StartOutput";
-    root["outputName"] = _outputName;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    static const char* const names[] = {
+#define OBS_EVENT_NAME(name) #name,
+        OBS_EVENT_TYPES(OBS_EVENT_NAME)
+#undef OBS_EVENT_NAME
+        "Unknown"
+    };
+    
+    return names[static_cast<std::size_t>(_type)];
 }
 
-void ObsMessageHandler::r_StopOutput(std::string& _outputName, bool _force)
+/* -------------------------------------------------------------- websocket framing ------------------------------------------------------------------------------------------------------   */
+
+static constexpr std::size_t maxFrameHeaderSize = 14;
+
+//RFC 6455 5.2, frames sent by a client are always masked; returns the header size including the masking key
+static std::size_t writeFrameHeader(uint8_t* _header, std::size_t _size, uint32_t _maskingKey)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(STOPOUTPUT);
-    root["request-type"] = "StopOutput";
-    root["outputName"] = _outputName;
-    root["force"] = _force;
+    std::size_t headerSize = 2;
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    _header[0] = 0x81;
+    if(_size < 126)
+    {
+        _header[1] = 0x80 | static_cast<uint8_t>(_size);
+    }
+    else if(_size < 65536)
+    {
+        _header[1] = 0x80 | 126;
+        _header[2] = static_cast<uint8_t>(_size >> 8);
+        _header[3] = static_cast<uint8_t>(_size);
+        headerSize = 4;
+    }
+    else
+    {
+        _header[1] = 0x80 | 127;
+        for(int i = 0; i < 8; i++) _header[2 + i] = static_cast<uint8_t>(static_cast<uint64_t>(_size) >> (56 - 8 * i));
+        headerSize = 10;
+    }
     
-    ws.write(net::buffer(json_file));
+    std::memcpy(_header + headerSize, &_maskingKey, 4);
+    return headerSize + 4;
 }
 
-void ObsMessageHandler::r_SetCurrentProfile(std::string& _profileName)
+static void appendTextFrame(std::string& _out, const char* _payload, std::size_t _size, uint32_t _maskingKey)
 {
-    Json::Value root;
+    uint8_t header[maxFrameHeaderSize];
+    const std::size_t headerSize = writeFrameHeader(header, _size, _maskingKey);
+    const uint8_t* maskingKey = header + headerSize - 4;
     
-    root["message-id"] = std::to_string(SETCURRENTPROFILE);
-    root["request-type"] = "SetCurrentProfile";
-    root["profile-name"] = _profileName;
+    const std::size_t start = _out.size();
+    _out.append(reinterpret_cast<const char*>(header), headerSize);
+    _out.append(_payload, _size);
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    uint8_t* payload = reinterpret_cast<uint8_t*>(&_out[start + headerSize]);
+    websocketmask::mask(payload, payload, _size, maskingKey);
 }
 
-void ObsMessageHandler::r_GetCurrentProfile()
+void FrameSocket::flush()
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETCURRENTPROFILE);
-    root["request-type"] = "GetCurrentProfile";
+    if(flushing || pendingBytes.size() == 0) return;
+    flushing = true;
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    writingBytes.clear();
+    swap(pendingBytes, writingBytes);
     
-    ws.write(net::buffer(json_file));
+    net::async_write(socket, writingBytes.data(), [this](beast::error_code _ec, std::size_t)
+    {
+        flushing = false;
+        
+        if(_ec)
+        {
+            std::cerr << "Error: " << _ec.message() << std::endl;
+            pendingBytes.clear();
+            return;
+        }
+        
+        flush();
+    });
 }
 
-void ObsMessageHandler::r_ListProfiles()
+/* -------------------------------------------------------------- constant requests ------------------------------------------------------------------------------------------------------   */
+
+struct ConstantRequestTemplate
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(LISTPROFILES);
-    root["request-type"] = "ListProfiles";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
-}
+    const char* requestType;
+    std::size_t requestTypeSize;
+    const char* prefix;
+    std::size_t prefixSize;
+};
+
+#define OBS_CONSTANT_PREFIX(name) "{\"request-type\":\"" #name "\",\"message-id\":\""
+
+static const ConstantRequestTemplate constantRequestTemplates[] = {
+#define OBS_CONSTANT_TEMPLATE(name) { #name, sizeof(#name) - 1, OBS_CONSTANT_PREFIX(name), sizeof(OBS_CONSTANT_PREFIX(name)) - 1 },
+    OBS_CONSTANT_REQUESTS(OBS_CONSTANT_TEMPLATE)
+#undef OBS_CONSTANT_TEMPLATE
+};
+
+//ConstantRequest is spelled out in the public header, the list has to follow it one for one
+static constexpr ConstantRequest constantRequestOrder[] = {
+#define OBS_CONSTANT_ORDER(name) ConstantRequest::name,
+    OBS_CONSTANT_REQUESTS(OBS_CONSTANT_ORDER)
+#undef OBS_CONSTANT_ORDER
+};
 
-void ObsMessageHandler::r_StartStopRecording()
+static constexpr std::size_t constantRequestCount = sizeof(constantRequestOrder) / sizeof(constantRequestOrder[0]);
+
+static constexpr bool constantRequestsInOrder(std::size_t _index = 0)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(STARTSTOPRECORDING);
-    root["request-type"] = "StartStopRecording";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    return _index == constantRequestCount || (static_cast<std::size_t>(constantRequestOrder[_index]) == _index && constantRequestsInOrder(_index + 1));
 }
 
-void ObsMessageHandler::r_StartRecording()
+static_assert(constantRequestsInOrder(), "OBS_CONSTANT_REQUESTS must list every ConstantRequest in declaration order");
+static_assert(static_cast<std::size_t>(ConstantRequest::GetSceneList) + 1 == constantRequestCount, "OBS_CONSTANT_REQUESTS must end with the last ConstantRequest");
+
+static constexpr std::size_t constantPrefixCapacity = std::max({
+#define OBS_CONSTANT_SIZE(name) sizeof(OBS_CONSTANT_PREFIX(name)),
+    OBS_CONSTANT_REQUESTS(OBS_CONSTANT_SIZE)
+#undef OBS_CONSTANT_SIZE
+});
+
+static std::size_t writeDecimal(char* _out, uint64_t _value)
 {
-    Json::Value root;
+    char digits[20];
+    std::size_t count = 0;
     
-    root["message-id"] = std::to_string(STARTRECORDING);
-    root["request-type"] = "StartRecording";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    do
+    {
+        digits[count++] = static_cast<char>('0' + _value % 10);
+        _value /= 10;
+    } while(_value != 0);
     
-    ws.write(net::buffer(json_file));
+    for(std::size_t i = 0; i < count; i++) _out[i] = digits[count - 1 - i];
+    return count;
 }
 
-void ObsMessageHandler::r_StopRecording()
+/* -------------------------------------------------------------- json frame writer ------------------------------------------------------------------------------------------------------   */
+
+JsonFrameWriter::JsonFrameWriter(std::string& _frames, bool _payloadOnly) : frames(_frames), frameStart(_frames.size()), headerSpace(_payloadOnly ? 0 : maxFrameHeaderSize)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(STOPRECORDING);
-    root["request-type"] = "StopRecording";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    //the largest header is reserved, finish() slides the payload down when a smaller one will do
+    frames.append(headerSpace, '\0');
+    frames.push_back('{');
 }
 
-void ObsMessageHandler::r_PauseRecording()
+JsonFrameWriter::~JsonFrameWriter()
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(PAUSERECORDING);
-    root["request-type"] = "PauseRecording";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    //half a frame would corrupt everything queued after it
+    if(!finished) frames.resize(frameStart);
 }
 
-void ObsMessageHandler::r_ResumeRecording()
+void JsonFrameWriter::field(const char* _key, const char* _value)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(RESUMERECORDING);
-    root["request-type"] = "ResumeRecording";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    string(_value, std::strlen(_value));
 }
 
-void ObsMessageHandler::r_SetRecordingFolder(std::string& _recFolder)
+void JsonFrameWriter::field(const char* _key, const char* _value, std::size_t _size)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(SETRECORDINGFOLDER);
-    root["request-type"] = "SetRecordingFolder";
-    root["rec-folder"] = _recFolder;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    string(_value, _size);
 }
 
-void ObsMessageHandler::r_GetRecordingFolder()
+void JsonFrameWriter::field(const char* _key, const std::string& _value)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETRECORDINGFOLDER);
-    root["request-type"] = "GetRecordingFolder";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    string(_value.data(), _value.size());
 }
 
-void ObsMessageHandler::r_StartStopReplayBufer()
+void JsonFrameWriter::field(const char* _key, int _value)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(STARTSTOPREPLAYBUFFER);
-    root["request-type"] = "StartStopReplayBuffer";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    integer(_value);
 }
 
-void ObsMessageHandler::r_StartReplayBuffer()
+void JsonFrameWriter::field(const char* _key, double _value)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(STARTREPLAYBUFFER);
-    root["request-type"] = "StartReplayBuffer";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    real(_value);
 }
 
-void ObsMessageHandler::r_StopReplayBuffer()
+void JsonFrameWriter::field(const char* _key, double _value, unsigned _decimals)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(STOPREPLAYBUFFER);
-    root["request-type"] = "StopReplayBuffer";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    fixed(_value, _decimals);
 }
 
-void ObsMessageHandler::r_SaveReplayBuffer()
+void JsonFrameWriter::field(const char* _key, bool _value)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(SAVEREPLAYBUFFER);
-    root["request-type"] = "SaveReplayBuffer";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    if(_value) frames.append("true", 4);
+    else frames.append("false", 5);
 }
 
-void ObsMessageHandler::r_SetCurrentSceneCollection(std::string& _scName)
+void JsonFrameWriter::field(const char* _key, const Json::Value& _value)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(SETCURRENTSCENECOLLECTION);
-    root["request-type"] = "SetCurrentSceneCollection";
-    root["sc-name"] = _scName;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    key(_key, std::strlen(_key));
+    value(_value);
 }
 
-void ObsMessageHandler::r_GetCurrentSceneCollection()
+void JsonFrameWriter::fields(const Json::Value& _object)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETCURRENTSCENECOLLECTION);
-    root["request-type"] = "GetCurrentSceneCollection";
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    for(Json::Value::const_iterator it = _object.begin(); it != _object.end(); ++it)
+    {
+        const char* end = nullptr;
+        const char* name = it.memberName(&end);
+        key(name, end - name);
+        value(*it);
+    }
 }
 
-void ObsMessageHandler::r_ListSceneCollections()
+void JsonFrameWriter::finish(uint32_t _maskingKey)
 {
-    Json::Value root;
+    frames.push_back('}');
     
-    root["message-id"] = std::to_string(LISTSCENECOLLECTIONS);
-    root["request-type"] = "ListSceneCollections";
+    const std::size_t size = frames.size() - frameStart - maxFrameHeaderSize;
+    uint8_t header[maxFrameHeaderSize];
+    const std::size_t headerSize = writeFrameHeader(header, size, _maskingKey);
+    const uint8_t* maskingKey = header + headerSize - 4;
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    //masking and sliding the payload over the unused header bytes is a single forward pass
+    uint8_t* frame = reinterpret_cast<uint8_t*>(&frames[frameStart]);
+    websocketmask::mask(frame + headerSize, frame + maxFrameHeaderSize, size, maskingKey);
+    std::memcpy(frame, header, headerSize);
     
-    ws.write(net::buffer(json_file));
+    frames.resize(frameStart + headerSize + size);
+    finished = true;
 }
 
-void ObsMessageHandler::r_GetSceneItemProperties(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5)
+void JsonFrameWriter::finish()
 {
-    //add different function if item = object
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETSCENEITEMPROPERTIES);
-    root["request-type"] = "GetSceneItemProperties";
-    if(_sceneName != "NULL") root["scene-name"] = _sceneName;
-    root["item"] = _item;
-    if(_itemName != "NULL") root["item.name"] = _itemName;
-    if(_itemId != -5) root["item.id"] = _itemId;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
-    
+    frames.push_back('}');
+    finished = true;
 }
 
-void ObsMessageHandler::r_SetSceneItemProperties(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5, Position _position = {-5, -5, -5}, double _rotation = -5, Scale _scale = {-5, -5}, Crop _crop = {-5, -5, -5, -5}, int _visible = -1, int _locked = -1, Bounds _bounds = {"NULL", -5, -5, -5})
+void JsonFrameWriter::key(const char* _key, std::size_t _size)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(SETSCENEITEMPROPERTIES);
-    root["request-type"] = "SetSceneItemProperties";
-    root["item"] = _item;
-    if(_sceneName != "NULL")        root["scene-name"] = _sceneName;
-    if(_itemName != "NULL")         root["item.name"] = _itemName;
-    if(_itemId != -5)               root["item.id"] = _itemId;
-    if(_position.x != -5)           root["position.x"] = _position.x;
-    if(_position.y != -5)           root["position.y"] = _position.y;
-    if(_position.alignment != -5)   root["position.alignment"] = _position.alignment;
-    if(_rotation != -5)             root["rotation"] = _rotation;
-    if(_scale.x != -5)              root["scale.x"] = _scale.x;
-    if(_scale.y != -5)              root["scale.y"] = _scale.y;
-    if(_crop.top != -5)             root["crop.top"] = _crop.top;
-    if(_crop.bottom != -5)          root["crop.bottom"] = _crop.bottom;
-    if(_crop.left != -5)            root["crop.left"] = _crop.left;
-    if(_crop.right != -5)           root["crop.right"] = _crop.right;
-    if(_visible != -1)              root["visible"] = _visible;
-    if(_locked != -1)               root["locked"] = _locked;
-    if(_bounds.type != "NULL")      root["bounds.type"] = _bounds.type;
-    if(_bounds.alignment != -5)     root["bounds.alignment"] = _bounds.alignment;
-    if(_bounds.x != -5)             root["bounds.x"] = _bounds.x;
-    if(_bounds.y != -5)             root["bounds.y"] = _bounds.y;
+    if(!firstField) frames.push_back(',');
+    firstField = false;
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    string(_key, _size);
+    frames.push_back(':');
 }
 
-void ObsMessageHandler::r_ResetSceneItem(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5)
+void JsonFrameWriter::string(const char* _value, std::size_t _size)
 {
-    Json::Value root;
+    static const char hexDigits[] = "0123456789abcdef";
     
-    root["message-id"] = std::to_string(RESETSCENEITEM);
-    root["request-type"] = "ResetSceneItem";
-    root["item"] = _item;
-    if(_sceneName != "NULL")        root["scene-name"] = _sceneName;
-    if(_itemName != "NULL")         root["item.name"] = _itemName;
-    if(_itemId != -5)               root["item.id"] = _itemId;
+    frames.push_back('"');
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    //unescaped runs are copied in one go, utf-8 passes through untouched
+    std::size_t run = 0;
+    for(std::size_t i = 0; i < _size; i++)
+    {
+        const unsigned char c = static_cast<unsigned char>(_value[i]);
+        if(c >= 0x20 && c != '"' && c != '\\') continue;
+        
+        frames.append(_value + run, i - run);
+        run = i + 1;
+        
+        switch(c)
+        {
+            case '"':  frames.append("\\\"", 2); break;
+            case '\\': frames.append("\\\\", 2); break;
+            case '\b': frames.append("\\b", 2); break;
+            case '\f': frames.append("\\f", 2); break;
+            case '\n': frames.append("\\n", 2); break;
+            case '\r': frames.append("\\r", 2); break;
+            case '\t': frames.append("\\t", 2); break;
+            default:
+            {
+                const char escape[6] = {'\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 15]};
+                frames.append(escape, 6);
+            }
+        }
+    }
     
-    ws.write(net::buffer(json_file));
+    frames.append(_value + run, _size - run);
+    frames.push_back('"');
 }
 
-void ObsMessageHandler::r_DeleteSceneItem(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5)
+void JsonFrameWriter::integer(int64_t _value)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(DELETESCENEITEM);
-    root["request-type"] = "DeleteSceneItem";
-    root["item"] = _item;
-    if(_sceneName != "NULL")        root["scene-name"] = _sceneName;
-    if(_itemName != "NULL")         root["item.name"] = _itemName;
-    if(_itemId != -5)               root["item.id"] = _itemId;
-    
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
-    
-    ws.write(net::buffer(json_file));
+    if(_value < 0)
+    {
+        frames.push_back('-');
+        unsignedInteger(0 - static_cast<uint64_t>(_value));
+    }
+    else
+    {
+        unsignedInteger(static_cast<uint64_t>(_value));
+    }
 }
 
-void ObsMessageHandler::r_DuplicateSceneItem()
+void JsonFrameWriter::unsignedInteger(uint64_t _value)
 {
-    //Not yet implimented
-    std::cout << "NOT YET IMPLIMENTED" << std::endl;
+    char digits[20];
+    frames.append(digits, writeDecimal(digits, _value));
 }
 
-void ObsMessageHandler::r_SetCurrentScene(std::string& _sceneName)
+void JsonFrameWriter::real(double _value)
 {
-    Json::Value root;
+    if(!std::isfinite(_value))
+    {
+        frames.append("null", 4);
+        return;
+    }
     
-    root["message-id"] = std::to_string(SETCURRENTSCENE);
-    root["request-type"] = "SetCurrentScene";
-    root["scene-name"] = _sceneName;
+    //17 significant digits round-trips every double, same as jsoncpp
+    char digits[32];
+    const int size = std::snprintf(digits, sizeof(digits), "%.17g", _value);
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    bool fraction = false;
+    for(int i = 0; i < size; i++)
+    {
+        //printf follows the locale's decimal point, json doesn't
+        if(digits[i] == ',') digits[i] = '.';
+        if(digits[i] == '.' || digits[i] == 'e') fraction = true;
+    }
     
-    ws.write(net::buffer(json_file));
+    frames.append(digits, size);
+    if(!fraction) frames.append(".0", 2);
 }
 
-void ObsMessageHandler::r_GetCurrentScene()
+void JsonFrameWriter::fixed(double _value, unsigned _decimals)
 {
-    Json::Value root;
-    
-    root["message-id"] = std::to_string(GETCURRENTSCENE);
-    root["request-type"] = "GetCurrentScene";
+    static const double scales[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    //integer formatting only, printf costs more than the rest of a frame together
+    const double scaled = _decimals < 7 ? std::round(std::fabs(_value) * scales[_decimals]) : 0;
+    if(_decimals >= 7 || !(scaled < 9e15))
+    {
+        real(_value);
+        return;
+    }
     
-    ws.write(net::buffer(json_file));
-}
-
-void ObsMessageHandler::r_GetSceneList()
-{
-    Json::Value root;
+    uint64_t units = static_cast<uint64_t>(scaled);
+    const uint64_t scale = static_cast<uint64_t>(scales[_decimals]);
+    if(_value < 0 && units != 0) frames.push_back('-');
+    unsignedInteger(units / scale);
+    frames.push_back('.');
     
-    root["message-id"] = std::to_string(GETSCENELIST);
-    root["request-type"] = "GetSceneList";
+    units %= scale;
+    if(units == 0)
+    {
+        frames.push_back('0');
+        return;
+    }
     
-    Json::StreamWriterBuilder builder;
-    const std::string json_file = Json::writeString(builder, root);
+    char digits[8];
+    for(unsigned i = _decimals; i > 0; --i)
+    {
+        digits[i - 1] = static_cast<char>('0' + units % 10);
+        units /= 10;
+    }
     
-    ws.write(net::buffer(json_file));
+    unsigned size = _decimals;
+    while(digits[size - 1] == '0') --size;
+    frames.append(digits, size);
 }
 
-void ObsMessageHandler::recieve()
+void JsonFrameWriter::value(const Json::Value& _value)
 {
-    
-    while(1){
-        try
+    switch(_value.type())
+    {
+        case Json::nullValue:
+            frames.append("null", 4);
+            break;
+        case Json::intValue:
+            integer(_value.asLargestInt());
+            break;
+        case Json::uintValue:
+            unsignedInteger(_value.asLargestUInt());
+            break;
+        case Json::realValue:
+            real(_value.asDouble());
+            break;
+        case Json::stringValue:
         {
-            beast::flat_buffer buffer;
-
-            // Read a message into our buffer
-            std::lock_guard<std::mutex> lock(recieveMutex);
-            ws.read(buffer);
-
-            // The make_printable() function helps print a ConstBufferSequence
-            std::cout << beast::make_printable(buffer.data()) << std::endl;
+            const char* begin = "";
+            const char* end = begin;
+            _value.getString(&begin, &end);
+            string(begin, end - begin);
+            break;
         }
-        catch(std::exception const& e)
+        case Json::booleanValue:
+            if(_value.asBool()) frames.append("true", 4);
+            else frames.append("false", 5);
+            break;
+        case Json::arrayValue:
         {
-            std::cerr << "Error: " << e.what() << std::endl;
+            frames.push_back('[');
+            for(Json::ArrayIndex i = 0; i < _value.size(); i++)
+            {
+                if(i != 0) frames.push_back(',');
+                value(_value[i]);
+            }
+            frames.push_back(']');
+            break;
+        }
+        case Json::objectValue:
+        {
+            const bool outerFirstField = firstField;
+            firstField = true;
+            frames.push_back('{');
+            fields(_value);
+            frames.push_back('}');
+            firstField = outerFirstField;
+            break;
         }
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-    
 }
 
+/* -------------------------------------------------------------- incoming messages ------------------------------------------------------------------------------------------------------   */
 
-
-/* -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------  */
-
-void ObsMessageHandler::e_GetVersion(std::string somekindofingo)
+//the scans only stop on bytes that change the structure, everything in between is skipped 16 bytes at a time
+static const char* findQuoteOrBackslash(const char* _p, const char* _end)
 {
-    std::cout << "hoi" << std::endl;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    
+    for(; _end - _p >= 16; _p += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_p));
+        const int hits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        if(hits != 0) return _p + __builtin_ctz(hits);
+    }
+#endif
+    
+    for(; _p < _end; _p++) if(*_p == '"' || *_p == '\\') return _p;
+    return _end;
 }
 
+static const char* findStructural(const char* _p, const char* _end)
+{
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i openBrace = _mm_set1_epi8('{');
+    const __m128i closeBrace = _mm_set1_epi8('}');
+    const __m128i openBracket = _mm_set1_epi8('[');
+    const __m128i closeBracket = _mm_set1_epi8(']');
+    
+    for(; _end - _p >= 16; _p += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_p));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, openBrace));
+        hits = _mm_or_si128(hits, _mm_or_si128(_mm_cmpeq_epi8(chunk, closeBrace), _mm_cmpeq_epi8(chunk, openBracket)));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, closeBracket));
+        
+        const int mask = _mm_movemask_epi8(hits);
+        if(mask != 0) return _p + __builtin_ctz(mask);
+    }
+#endif
+    
+    for(; _p < _end; _p++) if(*_p == '"' || *_p == '{' || *_p == '}' || *_p == '[' || *_p == ']') return _p;
+    return _end;
+}
+
+static const char* skipWhitespace(const char* _p, const char* _end)
+{
+    while(_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) _p++;
+    return _p;
+}
+
+//_p is just past the opening quote, returns just past the closing one or nullptr
+static const char* skipString(const char* _p, const char* _end)
+{
+    for(;;)
+    {
+        _p = findQuoteOrBackslash(_p, _end);
+        if(_p == _end) return nullptr;
+        if(*_p == '"') return _p + 1;
+        
+        _p += 2;
+        if(_p > _end) return nullptr;
+    }
+}
+
+static const char* skipValue(const char* _p, const char* _end)
+{
+    if(_p == _end) return nullptr;
+    if(*_p == '"') return skipString(_p + 1, _end);
+    
+    if(*_p == '{' || *_p == '[')
+    {
+        //nesting is counted, not validated, json() is what rejects mismatched brackets
+        int depth = 1;
+        _p++;
+        
+        while(depth > 0)
+        {
+            _p = findStructural(_p, _end);
+            if(_p == _end) return nullptr;
+            
+            if(*_p == '"')
+            {
+                _p = skipString(_p + 1, _end);
+                if(!_p) return nullptr;
+                continue;
+            }
+            
+            depth += (*_p == '{' || *_p == '[') ? 1 : -1;
+            _p++;
+        }
+        
+        return _p;
+    }
+    
+    //numbers, true, false and null
+    const char* start = _p;
+    while(_p < _end && *_p != ',' && *_p != '}' && *_p != ']' && *_p != ' ' && *_p != '\t' && *_p != '\n' && *_p != '\r') _p++;
+    return _p == start ? nullptr : _p;
+}
+
+//reads one "key":value pair and the separator after it, _last is set when that was the closing brace
+static const char* readMember(const char* _p, const char* _end, const char*& _key, std::size_t& _keySize, const char*& _value, std::size_t& _valueSize, bool& _last)
+{
+    if(_p == _end || *_p != '"') return nullptr;
+    
+    _key = _p + 1;
+    _p = skipString(_key, _end);
+    if(!_p) return nullptr;
+    _keySize = _p - 1 - _key;
+    
+    _p = skipWhitespace(_p, _end);
+    if(_p == _end || *_p != ':') return nullptr;
+    
+    _value = skipWhitespace(_p + 1, _end);
+    _p = skipValue(_value, _end);
+    if(!_p) return nullptr;
+    _valueSize = _p - _value;
+    
+    _p = skipWhitespace(_p, _end);
+    if(_p == _end || (*_p != ',' && *_p != '}')) return nullptr;
+    _last = *_p == '}';
+    
+    return skipWhitespace(_p + 1, _end);
+}
+
+static bool readHex4(const char* _p, const char* _end, uint32_t& _value)
+{
+    if(_end - _p < 4) return false;
+    
+    _value = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        const char c = _p[i];
+        uint32_t digit;
+        if(c >= '0' && c <= '9') digit = c - '0';
+        else if(c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+        else if(c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+        else return false;
+        _value = (_value << 4) | digit;
+    }
+    
+    return true;
+}
+
+static std::size_t writeUtf8(char* _out, uint32_t _codePoint)
+{
+    if(_codePoint < 0x80)
+    {
+        _out[0] = static_cast<char>(_codePoint);
+        return 1;
+    }
+    if(_codePoint < 0x800)
+    {
+        _out[0] = static_cast<char>(0xC0 | (_codePoint >> 6));
+        _out[1] = static_cast<char>(0x80 | (_codePoint & 0x3F));
+        return 2;
+    }
+    if(_codePoint < 0x10000)
+    {
+        _out[0] = static_cast<char>(0xE0 | (_codePoint >> 12));
+        _out[1] = static_cast<char>(0x80 | ((_codePoint >> 6) & 0x3F));
+        _out[2] = static_cast<char>(0x80 | (_codePoint & 0x3F));
+        return 3;
+    }
+    
+    _out[0] = static_cast<char>(0xF0 | (_codePoint >> 18));
+    _out[1] = static_cast<char>(0x80 | ((_codePoint >> 12) & 0x3F));
+    _out[2] = static_cast<char>(0x80 | ((_codePoint >> 6) & 0x3F));
+    _out[3] = static_cast<char>(0x80 | (_codePoint & 0x3F));
+    return 4;
+}
+
+//_p and _end bound the string without its quotes. Unescaping never grows a string, so _out needs
+//room for _end - _p bytes; returns the unescaped size or -1
+static std::ptrdiff_t unescapeString(const char* _p, const char* _end, char* _out)
+{
+    char* out = _out;
+    
+    while(_p < _end)
+    {
+        //skipString already matched the quotes, only backslashes can turn up here
+        const char* escape = findQuoteOrBackslash(_p, _end);
+        std::memcpy(out, _p, escape - _p);
+        out += escape - _p;
+        if(escape == _end) break;
+        
+        _p = escape + 2;
+        if(_p > _end) return -1;
+        
+        switch(escape[1])
+        {
+            case '"':  *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/':  *out++ = '/'; break;
+            case 'b':  *out++ = '\b'; break;
+            case 'f':  *out++ = '\f'; break;
+            case 'n':  *out++ = '\n'; break;
+            case 'r':  *out++ = '\r'; break;
+            case 't':  *out++ = '\t'; break;
+            case 'u':
+            {
+                uint32_t codePoint;
+                if(!readHex4(_p, _end, codePoint)) return -1;
+                _p += 4;
+                
+                //characters outside the BMP arrive as a surrogate pair
+                if(codePoint >= 0xD800 && codePoint < 0xDC00)
+                {
+                    uint32_t low;
+                    if(_end - _p < 6 || _p[0] != '\\' || _p[1] != 'u' || !readHex4(_p + 2, _end, low) || low < 0xDC00 || low > 0xDFFF) return -1;
+                    _p += 6;
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                
+                out += writeUtf8(out, codePoint);
+                break;
+            }
+            default: return -1;
+        }
+    }
+    
+    return out - _out;
+}
+
+static bool unescapeString(const char* _p, const char* _end, std::string& _out)
+{
+    _out.resize(_end - _p);
+    const std::ptrdiff_t size = unescapeString(_p, _end, &_out[0]);
+    _out.resize(size < 0 ? 0 : size);
+    return size >= 0;
+}
+
+static bool parseNumber(const char* _p, std::size_t _size, double& _value)
+{
+    //strtod wants a terminated string and follows the locale's decimal point, json doesn't
+    char digits[64];
+    if(_size == 0 || _size >= sizeof(digits)) return false;
+    
+    const char decimalPoint = *std::localeconv()->decimal_point;
+    for(std::size_t i = 0; i < _size; i++)
+    {
+        const char c = _p[i];
+        if((c < '0' || c > '9') && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E') return false;
+        digits[i] = c == '.' ? decimalPoint : c;
+    }
+    digits[_size] = '\0';
+    
+    char* end = nullptr;
+    _value = std::strtod(digits, &end);
+    return end == digits + _size;
+}
+
+//plain integers are read digit by digit so values past 2^53 stay exact, anything else has to be a number
+//with an integral value
+static bool parseInteger(const char* _p, std::size_t _size, int64_t& _value)
+{
+    const char* p = _p;
+    const char* end = _p + _size;
+    const bool negative = p < end && *p == '-';
+    if(negative) p++;
+    
+    const char* digits = p;
+    uint64_t magnitude = 0;
+    bool overflow = false;
+    for(; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        const unsigned digit = *p - '0';
+        overflow |= magnitude > (UINT64_MAX - digit) / 10;
+        magnitude = magnitude * 10 + digit;
+    }
+    
+    if(p == end && p != digits)
+    {
+        const uint64_t limit = negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX);
+        if(overflow || magnitude > limit) return false;
+        
+        _value = negative ? -static_cast<int64_t>(magnitude - 1) - 1 : static_cast<int64_t>(magnitude);
+        return true;
+    }
+    
+    double value;
+    if(!parseNumber(_p, _size, value) || value != std::floor(value) || std::fabs(value) > 9.2e18) return false;
+    _value = static_cast<int64_t>(value);
+    return true;
+}
+
+ObsMessage::ObsMessage(const char* _data, std::size_t _size, Json::CharReader* _reader) : frame(_data), frameSize(_size), reader(_reader)
+{
+    isValid = scan();
+}
+
+bool ObsMessage::scan()
+{
+    const char* end = frame + frameSize;
+    const char* p = skipWhitespace(frame, end);
+    if(p == end || *p != '{') return false;
+    
+    p = skipWhitespace(p + 1, end);
+    if(p != end && *p == '}') return true;
+    
+    bool last = false;
+    while(!last)
+    {
+        Member member;
+        const char* next = readMember(p, end, member.key, member.keySize, member.value, member.valueSize, last);
+        if(!next) return false;
+        
+        if(member.keySize == 10 && std::memcmp(member.key, "message-id", 10) == 0) messageIdField = member;
+        else if(member.keySize == 11 && std::memcmp(member.key, "update-type", 11) == 0) updateTypeField = member;
+        
+        if(memberCount < maxMembers) members[memberCount++] = member;
+        else if(!overflow) overflow = p;
+        
+        p = next;
+    }
+    
+    return true;
+}
+
+bool ObsMessage::find(const char* _key, Member& _member) const
+{
+    const std::size_t keySize = std::strlen(_key);
+    
+    for(int i = 0; i < memberCount; i++)
+    {
+        if(members[i].keySize != keySize || std::memcmp(members[i].key, _key, keySize) != 0) continue;
+        _member = members[i];
+        return true;
+    }
+    
+    if(!overflow) return false;
+    
+    //scan() already walked this part, it can't fail
+    const char* end = frame + frameSize;
+    const char* p = overflow;
+    bool last = false;
+    while(!last)
+    {
+        p = readMember(p, end, _member.key, _member.keySize, _member.value, _member.valueSize, last);
+        if(_member.keySize == keySize && std::memcmp(_member.key, _key, keySize) == 0) return true;
+    }
+    
+    return false;
+}
+
+uint64_t ObsMessage::messageId() const
+{
+    const Member& field = messageIdField;
+    if(!field.value || field.valueSize < 3 || field.valueSize > 21 || field.value[0] != '"') return 0;
+    
+    uint64_t messageId = 0;
+    for(std::size_t i = 1; i < field.valueSize - 1; i++)
+    {
+        const char c = field.value[i];
+        if(c < '0' || c > '9') return 0;
+        messageId = messageId * 10 + (c - '0');
+    }
+    
+    return messageId;
+}
+
+ObsEventType ObsMessage::eventType() const
+{
+    const Member& field = updateTypeField;
+    if(!field.value || field.valueSize < 2 || field.value[0] != '"') return ObsEventType::Unknown;
+    
+    //none of the known names need escaping, so an escaped value can't be one of them
+    if(std::memchr(field.value, '\\', field.valueSize)) return ObsEventType::Unknown;
+    return eventTypeFromString(field.value + 1, field.valueSize - 2);
+}
+
+std::string ObsMessage::updateType() const
+{
+    std::string updateType;
+    const Member& field = updateTypeField;
+    if(field.value && field.valueSize >= 2 && field.value[0] == '"') unescapeString(field.value + 1, field.value + field.valueSize - 1, updateType);
+    return updateType;
+}
+
+bool ObsMessage::has(const char* _key) const
+{
+    Member member;
+    return find(_key, member);
+}
+
+bool ObsMessage::getString(const char* _key, std::string& _value) const
+{
+    Member member;
+    if(!find(_key, member) || member.valueSize < 2 || member.value[0] != '"') return false;
+    return unescapeString(member.value + 1, member.value + member.valueSize - 1, _value);
+}
+
+bool ObsMessage::getNumber(const char* _key, double& _value) const
+{
+    Member member;
+    return find(_key, member) && parseNumber(member.value, member.valueSize, _value);
+}
+
+bool ObsMessage::getInt(const char* _key, int64_t& _value) const
+{
+    Member member;
+    return find(_key, member) && parseInteger(member.value, member.valueSize, _value);
+}
+
+bool ObsMessage::getBool(const char* _key, bool& _value) const
+{
+    Member member;
+    if(!find(_key, member)) return false;
+    
+    if(member.valueSize == 4 && std::memcmp(member.value, "true", 4) == 0) _value = true;
+    else if(member.valueSize == 5 && std::memcmp(member.value, "false", 5) == 0) _value = false;
+    else return false;
+    
+    return true;
+}
+
+const Json::Value& ObsMessage::json() const
+{
+    if(parsed) return document;
+    parsed = true;
+    
+    std::string errors;
+    if(!reader || !reader->parse(frame, frame + frameSize, &document, &errors))
+    {
+        if(reader) std::cerr << "Error: " << errors << std::endl;
+        document = Json::Value();
+    }
+    
+    return document;
+}
+
+/* -------------------------------------------------------------- typed responses --------------------------------------------------------------------------------------------------------   */
+
+ResponseArena::ResponseArena(ResponseArena&& _other) noexcept : blocks(_other.blocks), cursor(_other.cursor), limit(_other.limit), nextCapacity(_other.nextCapacity)
+{
+    _other.blocks = nullptr;
+    _other.cursor = _other.limit = nullptr;
+}
+
+ResponseArena& ResponseArena::operator=(ResponseArena&& _other) noexcept
+{
+    if(this == &_other) return *this;
+    
+    release();
+    blocks = _other.blocks;
+    cursor = _other.cursor;
+    limit = _other.limit;
+    nextCapacity = _other.nextCapacity;
+    
+    _other.blocks = nullptr;
+    _other.cursor = _other.limit = nullptr;
+    return *this;
+}
+
+ResponseArena::~ResponseArena()
+{
+    release();
+}
+
+void ResponseArena::release()
+{
+    while(blocks)
+    {
+        Block* next = blocks->next;
+        ::operator delete(blocks);
+        blocks = next;
+    }
+}
+
+void* ResponseArena::allocate(std::size_t _size, std::size_t _alignment)
+{
+    std::size_t padding = (_alignment - reinterpret_cast<std::uintptr_t>(cursor) % _alignment) % _alignment;
+    
+    if(!cursor || static_cast<std::size_t>(limit - cursor) < padding + _size)
+    {
+        //block memory is aligned for anything, the header is padded to keep it that way
+        const std::size_t header = (sizeof(Block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+        const std::size_t capacity = std::max(std::max(nextCapacity, _size), static_cast<std::size_t>(256));
+        
+        Block* block = static_cast<Block*>(::operator new(header + capacity));
+        block->next = blocks;
+        blocks = block;
+        
+        cursor = reinterpret_cast<char*>(block) + header;
+        limit = cursor + capacity;
+        nextCapacity = capacity * 2;
+        padding = 0;
+    }
+    
+    void* memory = cursor + padding;
+    cursor += padding + _size;
+    return memory;
+}
+
+template<std::size_t N>
+static bool keyIs(const char* _key, std::size_t _size, const char (&_name)[N])
+{
+    return _size == N - 1 && std::memcmp(_key, _name, N - 1) == 0;
+}
+
+//_visit(key, keySize, value, valueSize) for every member of the object in _p.._end
+template<class Visit>
+static bool forEachMember(const char* _p, const char* _end, const Visit& _visit)
+{
+    _p = skipWhitespace(_p, _end);
+    if(_p == _end || *_p != '{') return false;
+    
+    _p = skipWhitespace(_p + 1, _end);
+    if(_p != _end && *_p == '}') return true;
+    
+    bool last = false;
+    while(!last)
+    {
+        const char* key;
+        std::size_t keySize;
+        const char* value;
+        std::size_t valueSize;
+        
+        _p = readMember(_p, _end, key, keySize, value, valueSize, last);
+        if(!_p || !_visit(key, keySize, value, valueSize)) return false;
+    }
+    
+    return true;
+}
+
+//_visit(value, valueSize) for every element of the array in _p.._end
+template<class Visit>
+static bool forEachElement(const char* _p, const char* _end, const Visit& _visit)
+{
+    _p = skipWhitespace(_p, _end);
+    if(_p == _end || *_p != '[') return false;
+    
+    _p = skipWhitespace(_p + 1, _end);
+    if(_p != _end && *_p == ']') return true;
+    
+    for(;;)
+    {
+        const char* value = _p;
+        _p = skipValue(_p, _end);
+        if(!_p || !_visit(value, static_cast<std::size_t>(_p - value))) return false;
+        
+        _p = skipWhitespace(_p, _end);
+        if(_p == _end) return false;
+        if(*_p == ']') return true;
+        if(*_p != ',') return false;
+        _p = skipWhitespace(_p + 1, _end);
+    }
+}
+
+static bool isNull(const char* _value, std::size_t _size)
+{
+    return _size == 4 && std::memcmp(_value, "null", 4) == 0;
+}
+
+//a null leaves the default in place, anything else of the wrong type fails the decode
+static bool decodeValue(const char* _value, std::size_t _size, ResponseArena& _arena, ArenaString& _out)
+{
+    if(isNull(_value, _size)) return true;
+    if(_size < 2 || _value[0] != '"') return false;
+    
+    char* data = static_cast<char*>(_arena.allocate(_size - 2, 1));
+    const std::ptrdiff_t size = unescapeString(_value + 1, _value + _size - 1, data);
+    if(size < 0) return false;
+    
+    _out.data = data;
+    _out.size = size;
+    return true;
+}
+
+static bool decodeValue(const char* _value, std::size_t _size, ResponseArena&, std::string& _out)
+{
+    if(isNull(_value, _size)) return true;
+    return _size >= 2 && _value[0] == '"' && unescapeString(_value + 1, _value + _size - 1, _out);
+}
+
+static bool decodeValue(const char* _value, std::size_t _size, ResponseArena&, double& _out)
+{
+    return isNull(_value, _size) || parseNumber(_value, _size, _out);
+}
+
+static bool decodeValue(const char* _value, std::size_t _size, ResponseArena&, int64_t& _out)
+{
+    return isNull(_value, _size) || parseInteger(_value, _size, _out);
+}
+
+static bool decodeValue(const char* _value, std::size_t _size, ResponseArena&, int& _out)
+{
+    if(isNull(_value, _size)) return true;
+    
+    int64_t value;
+    if(!parseInteger(_value, _size, value) || value < INT_MIN || value > INT_MAX) return false;
+    _out = static_cast<int>(value);
+    return true;
+}
+
+static bool decodeValue(const char* _value, std::size_t _size, ResponseArena&, bool& _out)
+{
+    if(_size == 4 && std::memcmp(_value, "true", 4) == 0) _out = true;
+    else if(_size == 5 && std::memcmp(_value, "false", 5) == 0) _out = false;
+    else return isNull(_value, _size);
+    
+    return true;
+}
+
+template<class T>
+static bool decodeValue(const char* _value, std::size_t _size, ResponseArena& _arena, ArenaArray<T>& _out)
+{
+    if(isNull(_value, _size)) return true;
+    
+    //counted first so the elements land in one exactly sized array
+    std::size_t count = 0;
+    if(!forEachElement(_value, _value + _size, [&count](const char*, std::size_t){ count++; return true; })) return false;
+    
+    _out.items = _arena.construct<T>(count);
+    _out.count = count;
+    
+    std::size_t index = 0;
+    return forEachElement(_value, _value + _size, [&](const char* _element, std::size_t _elementSize)
+    {
+        return decodeValue(_element, _elementSize, _arena, _out.items[index++]);
+    });
+}
+
+//one case per field, keys that aren't listed are skipped
+#define OBS_DECODE_FIELD(key, member) if(keyIs(_key, _keySize, key)) return decodeValue(_value, _valueSize, _arena, _out.member);
+
+#define OBS_DECODE_OBJECT(Type, FIELDS) \
+    static bool decodeValue(const char* _object, std::size_t _objectSize, ResponseArena& _arena, Type& _out) \
+    { \
+        if(isNull(_object, _objectSize)) return true; \
+        return forEachMember(_object, _object + _objectSize, [&](const char* _key, std::size_t _keySize, const char* _value, std::size_t _valueSize) \
+        { \
+            FIELDS \
+            return true; \
+        }); \
+    }
+
+OBS_DECODE_OBJECT(ItemPosition,
+    OBS_DECODE_FIELD("x", x)
+    OBS_DECODE_FIELD("y", y)
+    OBS_DECODE_FIELD("alignment", alignment))
+
+OBS_DECODE_OBJECT(Scale,
+    OBS_DECODE_FIELD("x", x)
+    OBS_DECODE_FIELD("y", y))
+
+OBS_DECODE_OBJECT(Crop,
+    OBS_DECODE_FIELD("top", top)
+    OBS_DECODE_FIELD("bottom", bottom)
+    OBS_DECODE_FIELD("left", left)
+    OBS_DECODE_FIELD("right", right))
+
+OBS_DECODE_OBJECT(ItemBounds,
+    OBS_DECODE_FIELD("type", type)
+    OBS_DECODE_FIELD("alignment", alignment)
+    OBS_DECODE_FIELD("x", x)
+    OBS_DECODE_FIELD("y", y))
+
+OBS_DECODE_OBJECT(SceneItem,
+    OBS_DECODE_FIELD("name", name)
+    OBS_DECODE_FIELD("id", id)
+    OBS_DECODE_FIELD("type", type)
+    OBS_DECODE_FIELD("x", x)
+    OBS_DECODE_FIELD("y", y)
+    OBS_DECODE_FIELD("cx", cx)
+    OBS_DECODE_FIELD("cy", cy)
+    OBS_DECODE_FIELD("volume", volume)
+    OBS_DECODE_FIELD("source_cx", sourceCx)
+    OBS_DECODE_FIELD("source_cy", sourceCy)
+    OBS_DECODE_FIELD("alignment", alignment)
+    OBS_DECODE_FIELD("render", render)
+    OBS_DECODE_FIELD("muted", muted)
+    OBS_DECODE_FIELD("locked", locked)
+    OBS_DECODE_FIELD("parentGroupName", parentGroupName)
+    OBS_DECODE_FIELD("groupChildren", groupChildren))
+
+OBS_DECODE_OBJECT(Scene,
+    OBS_DECODE_FIELD("name", name)
+    OBS_DECODE_FIELD("sources", sources))
+
+OBS_DECODE_OBJECT(SceneList,
+    OBS_DECODE_FIELD("current-scene", currentScene)
+    OBS_DECODE_FIELD("scenes", scenes))
+
+OBS_DECODE_OBJECT(SceneItemProperties,
+    OBS_DECODE_FIELD("name", name)
+    OBS_DECODE_FIELD("itemId", itemId)
+    OBS_DECODE_FIELD("position", position)
+    OBS_DECODE_FIELD("rotation", rotation)
+    OBS_DECODE_FIELD("scale", scale)
+    OBS_DECODE_FIELD("crop", crop)
+    OBS_DECODE_FIELD("visible", visible)
+    OBS_DECODE_FIELD("muted", muted)
+    OBS_DECODE_FIELD("locked", locked)
+    OBS_DECODE_FIELD("bounds", bounds)
+    OBS_DECODE_FIELD("sourceWidth", sourceWidth)
+    OBS_DECODE_FIELD("sourceHeight", sourceHeight)
+    OBS_DECODE_FIELD("width", width)
+    OBS_DECODE_FIELD("height", height)
+    OBS_DECODE_FIELD("parentGroupName", parentGroupName))
+
+OBS_DECODE_OBJECT(OutputFlags,
+    OBS_DECODE_FIELD("rawValue", rawValue)
+    OBS_DECODE_FIELD("audio", audio)
+    OBS_DECODE_FIELD("video", video)
+    OBS_DECODE_FIELD("encoded", encoded)
+    OBS_DECODE_FIELD("multiTrack", multiTrack)
+    OBS_DECODE_FIELD("service", service))
+
+OBS_DECODE_OBJECT(Output,
+    OBS_DECODE_FIELD("name", name)
+    OBS_DECODE_FIELD("type", type)
+    OBS_DECODE_FIELD("width", width)
+    OBS_DECODE_FIELD("height", height)
+    OBS_DECODE_FIELD("flags", flags)
+    OBS_DECODE_FIELD("active", active)
+    OBS_DECODE_FIELD("reconnecting", reconnecting)
+    OBS_DECODE_FIELD("congestion", congestion)
+    OBS_DECODE_FIELD("totalFrames", totalFrames)
+    OBS_DECODE_FIELD("droppedFrames", droppedFrames)
+    OBS_DECODE_FIELD("totalBytes", totalBytes))
+
+OBS_DECODE_OBJECT(OutputList,
+    OBS_DECODE_FIELD("outputs", outputs))
+
+OBS_DECODE_OBJECT(ObsStats,
+    OBS_DECODE_FIELD("fps", fps)
+    OBS_DECODE_FIELD("render-total-frames", renderTotalFrames)
+    OBS_DECODE_FIELD("render-missed-frames", renderMissedFrames)
+    OBS_DECODE_FIELD("output-total-frames", outputTotalFrames)
+    OBS_DECODE_FIELD("output-skipped-frames", outputSkippedFrames)
+    OBS_DECODE_FIELD("average-frame-time", averageFrameTime)
+    OBS_DECODE_FIELD("cpu-usage", cpuUsage)
+    OBS_DECODE_FIELD("memory-usage", memoryUsage)
+    OBS_DECODE_FIELD("free-disk-space", freeDiskSpace))
+
+OBS_DECODE_OBJECT(VideoInfo,
+    OBS_DECODE_FIELD("baseWidth", baseWidth)
+    OBS_DECODE_FIELD("baseHeight", baseHeight)
+    OBS_DECODE_FIELD("outputWidth", outputWidth)
+    OBS_DECODE_FIELD("outputHeight", outputHeight)
+    OBS_DECODE_FIELD("scaleType", scaleType)
+    OBS_DECODE_FIELD("fps", fps)
+    OBS_DECODE_FIELD("videoFormat", videoFormat)
+    OBS_DECODE_FIELD("colorSpace", colorSpace)
+    OBS_DECODE_FIELD("colorRange", colorRange))
+
+//the counters come wrapped in a "stats" object
+struct StatsResponse
+{
+    ObsStats stats;
+};
+
+OBS_DECODE_OBJECT(StatsResponse,
+    OBS_DECODE_FIELD("stats", stats))
+
+#undef OBS_DECODE_OBJECT
+#undef OBS_DECODE_FIELD
+
+template<class T>
+static bool decodeTopLevel(const ObsMessage& _message, ResponseArena& _arena, T& _out, std::string& _error, const char* _requestType)
+{
+    std::string status;
+    if(_message.getString("status", status) && status == "error")
+    {
+        if(!_message.getString("error", _error)) _error = std::string(_requestType) + " failed";
+        return false;
+    }
+    
+    if(!_message.valid() || !decodeValue(_message.data(), _message.size(), _arena, _out))
+    {
+        _error = std::string("Malformed ") + _requestType + " response";
+        return false;
+    }
+    
+    return true;
+}
+
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, SceneList& _out, std::string& _error)
+{
+    return decodeTopLevel(_message, _arena, _out, _error, "GetSceneList");
+}
+
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, SceneItemProperties& _out, std::string& _error)
+{
+    return decodeTopLevel(_message, _arena, _out, _error, "GetSceneItemProperties");
+}
+
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, OutputList& _out, std::string& _error)
+{
+    return decodeTopLevel(_message, _arena, _out, _error, "ListOutputs");
+}
+
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, ObsStats& _out, std::string& _error)
+{
+    StatsResponse response;
+    if(!decodeTopLevel(_message, _arena, response, _error, "GetStats")) return false;
+    
+    _out = response.stats;
+    return true;
+}
+
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, VideoInfo& _out, std::string& _error)
+{
+    return decodeTopLevel(_message, _arena, _out, _error, "GetVideoInfo");
+}
+
+/* -------------------------------------------------------------- pending requests -------------------------------------------------------------------------------------------------------   */
+
+PendingRequest& PendingTable::insert(uint64_t _id)
+{
+    Slot* slot = &slots[_id & (slots.size() - 1)];
+    if(slot->id != 0)
+    {
+        if(count - stragglers.size() > slots.size() / 2)
+        {
+            resize(slots.size() * 2);
+            shrinkCountdown = slots.size();
+            slot = &slots[_id & (slots.size() - 1)];
+        }
+        if(slot->id != 0) setAside(*slot);
+    }
+    
+    slot->id = _id;
+    count++;
+    return slot->request;
+}
+
+bool PendingTable::take(uint64_t _id, ResponseCallback& _callback, std::string* _requestType)
+{
+    Slot& slot = slots[_id & (slots.size() - 1)];
+    if(slot.id == _id)
+    {
+        //the slot keeps its string capacity for the next request that lands here
+        _callback = std::move(slot.request.callback);
+        slot.request.callback = nullptr;
+        if(_requestType) *_requestType = slot.request.requestType;
+        slot.id = 0;
+    }
+    else
+    {
+        if(stragglers.empty()) return false;
+        
+        auto straggler = stragglers.find(_id);
+        if(straggler == stragglers.end()) return false;
+        
+        _callback = std::move(straggler->second.callback);
+        if(_requestType) *_requestType = std::move(straggler->second.requestType);
+        stragglers.erase(straggler);
+    }
+    count--;
+    
+    if(slots.size() > minSlots && count < slots.size() / 16 && --shrinkCountdown == 0)
+    {
+        resize(slots.size() / 2);
+        shrinkCountdown = slots.size();
+    }
+    return true;
+}
+
+void PendingTable::resize(std::size_t _slots)
+{
+    std::vector<Slot> old(_slots);
+    old.swap(slots);
+    
+    for(Slot& slot : old)
+    {
+        if(slot.id == 0) continue;
+        
+        Slot& target = slots[slot.id & (slots.size() - 1)];
+        if(target.id > slot.id)
+        {
+            setAside(slot);
+            continue;
+        }
+        if(target.id != 0) setAside(target);
+        target = std::move(slot);
+    }
+}
+
+void PendingTable::setAside(Slot& _slot)
+{
+    //the newer id takes the slot, the older one is the slow request
+    stragglers[_slot.id] = std::move(_slot.request);
+    _slot.request.callback = nullptr;
+    _slot.id = 0;
+}
+
+/* -------------------------------------------------------------- timer wheel ------------------------------------------------------------------------------------------------------------   */
+
+TimerWheel::TimerWheel(std::chrono::milliseconds _resolution) : origin(clock::now()), resolution(_resolution)
+{
+}
+
+void TimerWheel::place(const Entry& _entry)
+{
+    const uint64_t expiryTick = std::max(_entry.expiryTick, currentTick);
+    const uint64_t delta = expiryTick - currentTick;
+    
+    int level = 0;
+    while(level < levels - 1 && (delta >> (slotBits * (level + 1))) != 0) level++;
+    
+    slots[level][(expiryTick >> (slotBits * level)) & slotMask].push_back(Entry{_entry.id, expiryTick});
+}
+
+void TimerWheel::schedule(uint64_t _id, clock::time_point _deadline)
+{
+    //deadlines beyond the top level (46 hours at 10 ms) are clamped
+    const uint64_t maxDelta = (uint64_t(1) << (slotBits * levels)) - 1;
+    const auto sinceOrigin = std::chrono::duration_cast<std::chrono::milliseconds>(_deadline - origin);
+    uint64_t expiryTick = sinceOrigin.count() > 0 ? (sinceOrigin.count() + resolution.count() - 1) / resolution.count() : 0;
+    expiryTick = std::min(expiryTick, currentTick + maxDelta);
+    
+    place(Entry{_id, expiryTick});
+    count++;
+}
+
+void TimerWheel::advance(clock::time_point _now, std::vector<uint64_t>& _expired)
+{
+    const uint64_t nowTick = std::chrono::duration_cast<std::chrono::milliseconds>(_now - origin).count() / resolution.count();
+    
+    while(currentTick <= nowTick)
+    {
+        if(count == 0)
+        {
+            currentTick = nowTick + 1;
+            break;
+        }
+        
+        //pull the upper levels down as their slot comes up, highest first so entries can fall through
+        for(int level = levels - 1; level > 0; level--)
+        {
+            if((currentTick & ((uint64_t(1) << (slotBits * level)) - 1)) != 0) continue;
+            
+            cascading.clear();
+            cascading.swap(slots[level][(currentTick >> (slotBits * level)) & slotMask]);
+            for(const Entry& entry : cascading) place(entry);
+        }
+        
+        std::vector<Entry>& slot = slots[0][currentTick & slotMask];
+        for(const Entry& entry : slot) _expired.push_back(entry.id);
+        count -= slot.size();
+        slot.clear();
+        
+        currentTick++;
+    }
+}
+
+/* -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------  */
+
+ObsMessageHandler::ObsMessageHandler() : ownedContext(new net::io_context), ioc(*ownedContext), strand(net::make_strand(ioc)),
+    flushHandlerMemory(new HandlerMemory), pendingRequests(new PendingTable), timeoutWheel(new TimerWheel(std::chrono::milliseconds(10))){
+    Json::CharReaderBuilder builder;
+    jsonReader.reset(builder.newCharReader());
+}
+
+ObsMessageHandler::ObsMessageHandler(net::io_context& _ioc) : ioc(_ioc), strand(net::make_strand(ioc)),
+    flushHandlerMemory(new HandlerMemory), pendingRequests(new PendingTable), timeoutWheel(new TimerWheel(std::chrono::milliseconds(10))){
+    Json::CharReaderBuilder builder;
+    jsonReader.reset(builder.newCharReader());
+}
+
+ObsMessageHandler::~ObsMessageHandler(){
+    if(!ioThread.joinable()) return;
+    
+    close();
+    ioThread.join();
+}
+
+void ObsMessageHandler::close()
+{
+    //the stream belongs to the io thread, close it there and give OBS a second to answer
+    net::post(strand, [this]
+    {
+        //the destructor closes again after an explicit close(), Beast allows one close at a time
+        if(closing || stopped) return;
+        closing = true;
+        
+        //nothing to say goodbye to while a reconnect is pending
+        if(!connected) return shutDown();
+        
+        closeTimer.expires_after(std::chrono::seconds(1));
+        closeTimer.async_wait([this](beast::error_code _ec){ if(!_ec) shutDown(); });
+        ws->async_close(websocket::close_code::normal, [this](beast::error_code)
+        {
+            closeTimer.cancel();
+            shutDown();
+        });
+    });
+}
+
+void ObsMessageHandler::shutDown()
+{
+    //ends every chain this connection keeps going, so a shared io_context runs out of work once its handlers are done
+    stopped = true;
+    beast::error_code ec;
+    beast::get_lowest_layer(*ws).close(ec);
+    resolver.cancel();
+    reconnectTimer.cancel();
+    flushTimer.cancel();
+    animationTimer.cancel();
+    coalesceTimer.cancel();
+    wheelTimer.cancel();
+    
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        wheelTicking = false;
+        requestsRefused = true;
+    }
+    
+    //a flush still queued on a shared io_context must not register what was held
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        sessionOpen = false;
+    }
+    
+    ioWork.reset();
+    if(ownedContext) ioc.stop();
+    
+    //a close during a reconnect backoff has no read left to report it
+    std::lock_guard<std::mutex> lock(stateMutex);
+    closed = true;
+    closedCondition.notify_all();
+}
+
+static websocket::stream_base::decorator userAgent()
+{
+    return websocket::stream_base::decorator(
+    [](websocket::request_type& req)
+    {
+        req.set(http::field::user_agent,
+            std::string(BOOST_BEAST_VERSION_STRING) +
+                " websocket-client-coro");
+    });
+}
+
+void ObsMessageHandler::enableReconnect(bool _enable, std::chrono::milliseconds _initialDelay, std::chrono::milliseconds _maxDelay)
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        reconnectDelay = std::max(_initialDelay, std::chrono::milliseconds(1));
+        reconnectMaxDelay = std::max(_maxDelay, reconnectDelay);
+    }
+    
+    reconnectEnabled = _enable;
+}
+
+void ObsMessageHandler::setPassword(const std::string& _password)
+{
+    std::lock_guard<std::mutex> lock(stateMutex);
+    password = _password;
+    authSecrets.clear();
+}
+
+void ObsMessageHandler::scheduleReconnect()
+{
+    if(stopped) return;
+    
+    std::chrono::milliseconds ceiling;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ceiling = reconnectDelay * (1u << std::min(reconnectAttempt, 16u));
+        ceiling = std::min(ceiling, reconnectMaxDelay);
+    }
+    reconnectAttempt++;
+    
+    //anywhere in the upper half, so a wall of clients that lost the same OBS doesn't come back in lockstep
+    const std::chrono::milliseconds delay = ceiling / 2 + std::chrono::milliseconds(reconnectJitter() % (ceiling.count() / 2 + 1));
+    reconnectTimer.expires_after(delay);
+    reconnectTimer.async_wait([this](beast::error_code _ec)
+    {
+        if(!_ec && !stopped) reconnect();
+    });
+}
+
+void ObsMessageHandler::reconnect()
+{
+    //Beast's stream can't be handshaken again once it has failed twice, every connection gets a fresh one
+    beast::error_code ec;
+    beast::get_lowest_layer(*ws).close(ec);
+    retiredWs = std::move(ws);
+    ws.reset(new websocket::stream<FrameSocket>(strand));
+    ws->set_option(userAgent());
+    
+    //a host that swallows the SYN would otherwise hold the attempt for minutes
+    reconnectTimer.expires_after(std::chrono::seconds(2));
+    reconnectTimer.async_wait([this](beast::error_code _ec)
+    {
+        beast::error_code ec;
+        if(!_ec && !connected) beast::get_lowest_layer(*ws).close(ec);
+    });
+    
+    auto handshake = [this](beast::error_code _ec, const tcp::endpoint&)
+    {
+        if(_ec)
+        {
+            //the address may have moved, look it up again next time
+            endpoints = tcp::resolver::results_type();
+            return scheduleReconnect();
+        }
+        
+        beast::error_code ec;
+        beast::get_lowest_layer(*ws).set_option(tcp::no_delay(true), ec);
+        ws->async_handshake(host, "/", [this](beast::error_code _ec)
+        {
+            if(_ec) return scheduleReconnect();
+            
+            reconnectTimer.cancel();
+            connected = true;
+            resumeSession();
+        });
+    };
+    
+    //the endpoints from the last lookup are tried first, resolving again only when they stop working
+    if(!endpoints.empty())
+    {
+        net::async_connect(beast::get_lowest_layer(*ws), endpoints, handshake);
+        return;
+    }
+    
+    resolver.async_resolve(host, port, [this, handshake](beast::error_code _ec, tcp::resolver::results_type _results)
+    {
+        if(_ec) return scheduleReconnect();
+        
+        endpoints = _results;
+        net::async_connect(beast::get_lowest_layer(*ws), endpoints, handshake);
+    });
+}
+
+static std::exception_ptr notConnected()
+{
+    return std::make_exception_ptr(std::runtime_error("Not connected."));
+}
+
+template<class WriteFields>
+void ObsMessageHandler::sendSessionRequest(const char* _requestType, ResponseCallback _callback, const WriteFields& _writeFields)
+{
+    //io thread. Goes straight to the socket, past the queue that is held until the session is open
+    const std::size_t requestTypeSize = std::strlen(_requestType);
+    const uint64_t messageId = registerRequest(_requestType, requestTypeSize, _callback, std::chrono::milliseconds(0));
+    if(messageId == 0) return _callback(ObsMessage(), notConnected());
+    
+    char messageIdString[20];
+    const std::size_t messageIdSize = writeDecimal(messageIdString, messageId);
+    
+    std::string frame;
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        JsonFrameWriter json(frame);
+        json.field("request-type", _requestType, requestTypeSize);
+        json.field("message-id", messageIdString, messageIdSize);
+        _writeFields(json);
+        json.finish(maskGenerator());
+    }
+    
+    beast::flat_buffer& outgoing = ws->next_layer().outgoing();
+    outgoing.commit(net::buffer_copy(outgoing.prepare(frame.size()), net::buffer(frame)));
+    ws->next_layer().flush();
+}
+
+void ObsMessageHandler::resumeSession()
+{
+    const uint64_t current = ++session;
+    
+    std::string secret;
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        secret = password;
+    }
+    
+    //a reconnect picks up reading where the old connection left off, authenticating needs it either way
+    if(reading || !secret.empty())
+    {
+        reading = true;
+        readBuffer.clear();
+        doRead();
+    }
+    
+    if(secret.empty()) return openSession(current);
+    
+    sendSessionRequest("GetAuthRequired", [this, current, secret](const ObsMessage& _response, std::exception_ptr _error)
+    {
+        if(current != session) return;
+        
+        bool required = false;
+        std::string challenge, salt;
+        if(_error || !_response.getBool("authRequired", required) || !required) return openSession(current);
+        if(!_response.getString("challenge", challenge) || !_response.getString("salt", salt)) return openSession(current);
+        
+        const std::string auth = authResponse(secret, salt, challenge);
+        sendSessionRequest("Authenticate", [this, current](const ObsMessage& _response, std::exception_ptr _error)
+        {
+            if(current != session) return;
+            
+            std::string status;
+            if(_error || (_response.getString("status", status) && status == "error")) std::cerr << "Error: authentication failed" << std::endl;
+            openSession(current);
+        }, [&](JsonFrameWriter& _json)
+        {
+            _json.field("auth", auth);
+        });
+    }, [](JsonFrameWriter&){});
+}
+
+void ObsMessageHandler::openSession(uint64_t _session)
+{
+    if(_session != session) return;
+    reconnectAttempt = 0;
+    
+    //the only per-session subscription obs-websocket 4.x has, event handlers are local and stay as they are
+    const int heartbeatEnabled = heartbeat;
+    if(heartbeatEnabled >= 0)
+    {
+        sendSessionRequest("SetHeartbeat", [](const ObsMessage&, std::exception_ptr){}, [&](JsonFrameWriter& _json)
+        {
+            _json.field("enable", heartbeatEnabled == 1);
+        });
+    }
+    
+    if(sceneCacheEnabled && _session > 1) resyncSceneState();
+    
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        sessionOpen = true;
+    }
+    
+    //whatever was asked for while the session was down
+    flush();
+}
+
+ConnectionHealth ObsMessageHandler::health() const
+{
+    ConnectionHealth health;
+    health.connected = connected;
+    
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        health.pendingRequests = pendingRequests->size();
+    }
+    
+    const std::chrono::steady_clock::rep lastMessage = lastMessageAt;
+    if(lastMessage != 0) health.silence = std::chrono::steady_clock::now() - std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(lastMessage));
+    
+    return health;
+}
+
+bool ObsMessageHandler::connect(std::string& _host, std::string& _port)
+{
+    host = _host;
+    port = _port;
+    
+    try
+    {
+        endpoints = resolver.resolve(_host, _port);
+        net::connect(beast::get_lowest_layer(*ws), endpoints.begin(), endpoints.end());
+        
+        //frames are coalesced by the send queue, Nagle would only add latency on top
+        beast::get_lowest_layer(*ws).set_option(tcp::no_delay(true));
+        
+        ws->set_option(userAgent());
+        
+        ws->handshake(_host, "/");
+        connected = true;
+        net::post(strand, [this]{ resumeSession(); });
+    }
+    catch(std::exception const& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        
+        //keeps trying in the background, requests made meanwhile are held
+        if(reconnectEnabled) net::post(strand, [this]{ scheduleReconnect(); });
+        else refuseRequests();
+    }
+    
+    //request timeouts are driven from the io thread, a shared io_context is run by its owner
+    if(ownedContext && !ioThread.joinable()) ioThread = std::thread([this]{ ioc.run(); });
+    
+    return connected;
+}
+
+void ObsMessageHandler::refuseRequests()
+{
+    //nothing will send or time out a request again, new ones fail as they are made
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    requestsRefused = true;
+}
+
+bool ObsMessageHandler::refusingRequests() const
+{
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    return requestsRefused;
+}
+
+static ResponseCallback promiseCallback(const std::shared_ptr<std::promise<Json::Value>>& _promise)
+{
+    return [_promise](const ObsMessage& _response, std::exception_ptr _error)
+    {
+        if(_error) _promise->set_exception(_error);
+        else _promise->set_value(_response.json());
+    };
+}
+
+std::future<Json::Value> ObsMessageHandler::sendRequest(Json::Value& _request, std::chrono::milliseconds _timeout)
+{
+    std::shared_ptr<std::promise<Json::Value>> promise = std::make_shared<std::promise<Json::Value>>();
+    std::future<Json::Value> future = promise->get_future();
+    
+    sendRequest(_request, promiseCallback(promise), _timeout);
+    
+    return future;
+}
+
+void ObsMessageHandler::sendRequest(Json::Value& _request, ResponseCallback _callback, std::chrono::milliseconds _timeout)
+{
+    const char* requestType = "";
+    const char* requestTypeEnd = requestType;
+    _request["request-type"].getString(&requestType, &requestTypeEnd);
+    
+    const uint64_t messageId = registerRequest(requestType, requestTypeEnd - requestType, _callback, _timeout);
+    if(messageId == 0) return _callback(ObsMessage(), notConnected());
+    _request["message-id"] = std::to_string(messageId);
+    
+    std::lock_guard<std::mutex> lock(sendMutex);
+    JsonFrameWriter json(queuedFrames);
+    json.fields(_request);
+    json.finish(maskGenerator());
+    scheduleFlush();
+}
+
+template<class WriteFields>
+std::future<Json::Value> ObsMessageHandler::sendFields(const char* _requestType, const WriteFields& _writeFields)
+{
+    std::shared_ptr<std::promise<Json::Value>> promise = std::make_shared<std::promise<Json::Value>>();
+    std::future<Json::Value> future = promise->get_future();
+    
+    sendFields(_requestType, promiseCallback(promise), std::chrono::milliseconds(0), _writeFields);
+    
+    return future;
+}
+
+template<class WriteFields>
+void ObsMessageHandler::sendFields(const char* _requestType, ResponseCallback _callback, std::chrono::milliseconds _timeout, const WriteFields& _writeFields)
+{
+    const std::size_t requestTypeSize = std::strlen(_requestType);
+    const uint64_t messageId = registerRequest(_requestType, requestTypeSize, _callback, _timeout);
+    if(messageId == 0) return _callback(ObsMessage(), notConnected());
+    
+    char messageIdString[20];
+    const std::size_t messageIdSize = writeDecimal(messageIdString, messageId);
+    
+    //the fields are written straight into the queued frames, no Json::Value and no intermediate string
+    std::lock_guard<std::mutex> lock(sendMutex);
+    JsonFrameWriter json(queuedFrames);
+    json.field("request-type", _requestType, requestTypeSize);
+    json.field("message-id", messageIdString, messageIdSize);
+    _writeFields(json);
+    json.finish(maskGenerator());
+    scheduleFlush();
+}
+
+std::future<Json::Value> ObsMessageHandler::sendRequest(ConstantRequest _request, std::chrono::milliseconds _timeout)
+{
+    std::shared_ptr<std::promise<Json::Value>> promise = std::make_shared<std::promise<Json::Value>>();
+    std::future<Json::Value> future = promise->get_future();
+    
+    sendRequest(_request, promiseCallback(promise), _timeout);
+    
+    return future;
+}
+
+void ObsMessageHandler::sendRequest(ConstantRequest _request, ResponseCallback _callback, std::chrono::milliseconds _timeout)
+{
+    const ConstantRequestTemplate& request = constantRequestTemplates[static_cast<std::size_t>(_request)];
+    const uint64_t messageId = registerRequest(request.requestType, request.requestTypeSize, _callback, _timeout);
+    if(messageId == 0) return _callback(ObsMessage(), notConnected());
+    
+    char payload[constantPrefixCapacity + 22];
+    std::memcpy(payload, request.prefix, request.prefixSize);
+    std::size_t size = request.prefixSize + writeDecimal(payload + request.prefixSize, messageId);
+    payload[size++] = '"';
+    payload[size++] = '}';
+    
+    queueFrame(payload, size);
+}
+
+uint64_t ObsMessageHandler::registerRequest(const char* _requestType, std::size_t _size, ResponseCallback& _callback, std::chrono::milliseconds _timeout)
+{
+    //zero when the request was refused, _callback is left to the caller then
+    const uint64_t messageId = nextMessageId++;
+    return registerRequest(messageId, _requestType, _size, _callback, _timeout) ? messageId : 0;
+}
+
+bool ObsMessageHandler::registerRequest(uint64_t _messageId, const char* _requestType, std::size_t _size, ResponseCallback& _callback, std::chrono::milliseconds _timeout)
+{
+    //register before queueing, the response may arrive before the caller gets control back
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    if(requestsRefused) return false;
+    
+    PendingRequest& request = pendingRequests->insert(_messageId);
+    request.requestType.assign(_requestType, _size);
+    request.callback = std::move(_callback);
+    timeoutWheel->schedule(_messageId, TimerWheel::clock::now() + (_timeout.count() > 0 ? _timeout : requestTimeout));
+    
+    if(!wheelTicking)
+    {
+        wheelTicking = true;
+        net::post(strand, [this]{ onWheelTick(); });
+    }
+    
+    return true;
+}
+
+bool ObsMessageHandler::reserveMessageId(uint64_t _messageId)
+{
+    //false when this connection already handed it out
+    uint64_t next = nextMessageId;
+    while(next <= _messageId)
+    {
+        if(nextMessageId.compare_exchange_weak(next, _messageId + 1)) return true;
+    }
+    
+    return false;
+}
+
+void ObsMessageHandler::sendShared(const std::shared_ptr<const std::string>& _payload, uint64_t _messageId, const std::string& _requestType, ResponseCallback _callback)
+{
+    if(!registerRequest(_messageId, _requestType.data(), _requestType.size(), _callback, std::chrono::milliseconds(0))) return _callback(ObsMessage(), notConnected());
+    
+    //masked on this connection's strand, so a pool masks the copies for many connections side by side
+    net::post(strand, [this, _payload]
+    {
+        {
+            std::lock_guard<std::mutex> lock(sendMutex);
+            appendTextFrame(queuedFrames, _payload->data(), _payload->size(), maskGenerator());
+            
+            if(writing || flushMode != FlushMode::Immediate)
+            {
+                scheduleFlush();
+                return;
+            }
+            
+            writing = true;
+        }
+        
+        //already on the io thread, posting the flush would only add a hop
+        flushQueue();
+    });
+}
+
+void ObsMessageHandler::queueFrame(const char* _payload, std::size_t _size)
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    appendTextFrame(queuedFrames, _payload, _size, maskGenerator());
+    scheduleFlush();
+}
+
+void ObsMessageHandler::scheduleFlush()
+{
+    //sendMutex is held
+    if(writing || flushMode == FlushMode::Manual) return;
+    writing = true;
+    postFlush(flushMode == FlushMode::Window);
+}
+
+//posted from the callers' threads, carries its own allocator so the post doesn't allocate
+struct FlushHandler
+{
+    typedef HandlerAllocator<FlushHandler> allocator_type;
+    
+    ObsMessageHandler* owner;
+    
+    allocator_type get_allocator() const noexcept { return allocator_type(*owner->flushHandlerMemory); }
+    void operator()() const { owner->flushQueue(); }
+};
+
+void ObsMessageHandler::postFlush(bool _windowed)
+{
+    //sendMutex is held
+    if(_windowed)
+    {
+        const std::chrono::microseconds window = flushWindow;
+        net::post(strand, [this, window]
+        {
+            flushTimer.expires_after(window);
+            flushTimer.async_wait([this](beast::error_code){ flushQueue(); });
+        });
+    }
+    else
+    {
+        net::post(strand, FlushHandler{this});
+    }
+}
+
+void ObsMessageHandler::setFlushMode(FlushMode _mode, std::chrono::microseconds _window)
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    flushMode = _mode;
+    flushWindow = _window;
+}
+
+void ObsMessageHandler::flush()
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if(writing || (queuedFrames.size() == 0 && heldRequests.empty())) return;
+    writing = true;
+    postFlush(false);
+}
+
+void ObsMessageHandler::flushQueue()
+{
+    //everything queued so far joins the socket's outgoing buffer and leaves in a single write
+    beast::flat_buffer& outgoing = ws->next_layer().outgoing();
+    
+    {
+        std::lock_guard<std::mutex> lock(sendMutex);
+        writing = false;
+        if(!sessionOpen) return;
+        
+        if(!heldRequests.empty()) releaseCoalesced();
+        outgoing.commit(net::buffer_copy(outgoing.prepare(queuedFrames.size()), net::buffer(queuedFrames)));
+        queuedFrames.clear();
+    }
+    
+    ws->next_layer().flush();
+}
+
+void ObsMessageHandler::setRequestTimeout(std::chrono::milliseconds _timeout)
+{
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    requestTimeout = _timeout;
+}
+
+bool ObsMessageHandler::completeRequest(const ObsMessage& _response)
+{
+    const uint64_t messageId = _response.messageId();
+    if(messageId == 0) return false;
+    
+    ResponseCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if(!pendingRequests->take(messageId, callback)) return false;
+    }
+    
+    callback(_response, nullptr);
+    return true;
+}
+
+uint64_t ObsMessageHandler::onEvent(ObsEventType _type, EventCallback _callback)
+{
+    if(_type == ObsEventType::Unknown) throw std::invalid_argument("Cannot register a handler for ObsEventType::Unknown.");
+    
+    std::lock_guard<std::mutex> lock(eventMutex);
+    EventHandlerList& list = eventHandlers[static_cast<std::size_t>(_type)];
+    
+    std::shared_ptr<std::vector<EventHandler>> handlers = list ? std::make_shared<std::vector<EventHandler>>(*list) : std::make_shared<std::vector<EventHandler>>();
+    handlers->push_back(EventHandler{nextEventHandlerId, std::move(_callback)});
+    list = handlers;
+    
+    return nextEventHandlerId++;
+}
+
+uint64_t ObsMessageHandler::onEvent(const std::string& _updateType, EventCallback _callback)
+{
+    const ObsEventType type = eventTypeFromString(_updateType.data(), _updateType.size());
+    if(type != ObsEventType::Unknown) return onEvent(type, std::move(_callback));
+    
+    std::lock_guard<std::mutex> lock(eventMutex);
+    EventHandlerList& list = customEventHandlers[_updateType];
+    
+    std::shared_ptr<std::vector<EventHandler>> handlers = list ? std::make_shared<std::vector<EventHandler>>(*list) : std::make_shared<std::vector<EventHandler>>();
+    handlers->push_back(EventHandler{nextEventHandlerId, std::move(_callback)});
+    list = handlers;
+    
+    return nextEventHandlerId++;
+}
+
+void ObsMessageHandler::removeEventHandler(uint64_t _handlerId)
+{
+    auto remove = [_handlerId](EventHandlerList& _list)
+    {
+        if(!_list) return;
+        std::shared_ptr<std::vector<EventHandler>> handlers = std::make_shared<std::vector<EventHandler>>(*_list);
+        handlers->erase(std::remove_if(handlers->begin(), handlers->end(), [_handlerId](const EventHandler& _handler){ return _handler.id == _handlerId; }), handlers->end());
+        if(handlers->size() != _list->size()) _list = handlers;
+    };
+    
+    std::lock_guard<std::mutex> lock(eventMutex);
+    for(EventHandlerList& list : eventHandlers) remove(list);
+    for(auto& custom : customEventHandlers) remove(custom.second);
+}
+
+void ObsMessageHandler::dispatchEvent(const ObsMessage& _event)
+{
+    const ObsEventType type = _event.eventType();
+    
+    EventHandlerList handlers;
+    {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        if(type != ObsEventType::Unknown)
+        {
+            handlers = eventHandlers[static_cast<std::size_t>(type)];
+        }
+        else if(!customEventHandlers.empty())
+        {
+            auto it = customEventHandlers.find(_event.updateType());
+            if(it != customEventHandlers.end()) handlers = it->second;
+        }
+    }
+    
+    if(!handlers) return;
+    for(const EventHandler& handler : *handlers) handler.callback(_event);
+}
+
+void ObsMessageHandler::onWheelTick()
+{
+    std::vector<PendingRequest> timedOut;
+    bool keepTicking;
+    
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        expiredIds.clear();
+        timeoutWheel->advance(TimerWheel::clock::now(), expiredIds);
+        
+        //most of these completed long ago, cancelling is lazy
+        for(uint64_t messageId : expiredIds)
+        {
+            PendingRequest request;
+            if(!pendingRequests->take(messageId, request.callback, &request.requestType)) continue;
+            timedOut.push_back(std::move(request));
+        }
+        
+        keepTicking = !timeoutWheel->empty() && !stopped;
+        wheelTicking = keepTicking;
+    }
+    
+    for(PendingRequest& request : timedOut)
+    {
+        request.callback(ObsMessage(), std::make_exception_ptr(ObsRequestTimeout(request.requestType)));
+    }
+    
+    if(keepTicking)
+    {
+        wheelTimer.expires_at(timeoutWheel->nextTick());
+        wheelTimer.async_wait([this](beast::error_code _ec)
+        {
+            if(!_ec) onWheelTick();
+        });
+    }
+}
+
+/* -------------------------------------------------------------- coalescing -------------------------------------------------------------------------------------------------------------   */
+
+static void writeTransformFields(JsonFrameWriter& _json, const ItemPosition& _position, double _rotation, const Scale& _scale, const Crop& _crop, int _visible, int _locked, const ItemBounds& _bounds)
+{
+    if(_position.x != -5)           _json.field("position.x", _position.x);
+    if(_position.y != -5)           _json.field("position.y", _position.y);
+    if(_position.alignment != -5)   _json.field("position.alignment", _position.alignment);
+    if(_rotation != -5)             _json.field("rotation", _rotation);
+    if(_scale.x != -5)              _json.field("scale.x", _scale.x);
+    if(_scale.y != -5)              _json.field("scale.y", _scale.y);
+    if(_crop.top != -5)             _json.field("crop.top", _crop.top);
+    if(_crop.bottom != -5)          _json.field("crop.bottom", _crop.bottom);
+    if(_crop.left != -5)            _json.field("crop.left", _crop.left);
+    if(_crop.right != -5)           _json.field("crop.right", _crop.right);
+    if(_visible != -1)              _json.field("visible", _visible);
+    if(_locked != -1)               _json.field("locked", _locked);
+    if(_bounds.type != "NULL")      _json.field("bounds.type", _bounds.type);
+    if(_bounds.alignment != -5)     _json.field("bounds.alignment", _bounds.alignment);
+    if(_bounds.x != -5)             _json.field("bounds.x", _bounds.x);
+    if(_bounds.y != -5)             _json.field("bounds.y", _bounds.y);
+}
+
+template<class T>
+static void takeIfSet(T& _held, const T& _value, const T& _unset)
+{
+    if(!(_value == _unset)) _held = _value;
+}
+
+void ObsMessageHandler::enableCoalescing(bool _enable, std::chrono::microseconds _minInterval)
+{
+    std::lock_guard<std::mutex> lock(sendMutex);
+    coalesceInterval = _minInterval;
+    for(std::pair<const std::string, CoalescedRequest>& request : coalescedRequests)
+    {
+        if(!request.second.ownRateCap) request.second.minInterval = _minInterval;
+    }
+    
+    //whatever is held still goes out with the next flush
+    coalescingEnabled = _enable;
+}
+
+void ObsMessageHandler::setRateCap(const std::string& _requestType, const std::string& _sceneName, const std::string& _item, std::chrono::microseconds _minInterval)
+{
+    static const char* const coalescedTypes[] = {"SetSceneItemProperties", "SetCurrentScene"};
+    
+    const char* requestType = nullptr;
+    for(const char* type : coalescedTypes)
+    {
+        if(_requestType == type) requestType = type;
+    }
+    
+    if(!requestType) throw std::invalid_argument("Only SetSceneItemProperties and SetCurrentScene are coalesced.");
+    
+    std::lock_guard<std::mutex> lock(sendMutex);
+    CoalescedRequest& request = coalescedRequest(requestType, _sceneName, _item);
+    request.minInterval = _minInterval;
+    request.ownRateCap = true;
+}
+
+CoalescedRequest& ObsMessageHandler::coalescedRequest(const char* _requestType, const std::string& _sceneName, const std::string& _item)
+{
+    //sendMutex is held
+    coalesceKey.assign(_requestType);
+    coalesceKey.push_back('\0');
+    coalesceKey.append(_sceneName);
+    coalesceKey.push_back('\0');
+    coalesceKey.append(_item);
+    
+    std::unordered_map<std::string, CoalescedRequest>::iterator request = coalescedRequests.find(coalesceKey);
+    if(request != coalescedRequests.end()) return request->second;
+    
+    CoalescedRequest& added = coalescedRequests[coalesceKey];
+    added.requestType = _requestType;
+    added.sceneName = _sceneName;
+    added.item = _item;
+    added.minInterval = coalesceInterval;
+    return added;
+}
+
+bool ObsMessageHandler::holdCoalesced(CoalescedRequest& _request, ResponseCallback& _callback)
+{
+    //sendMutex is held, the caller has merged its fields into _request. False when requests are refused
+    if(refusingRequests()) return false;
+    
+    _request.waiters.push_back(std::move(_callback));
+    if(_request.held) return true;
+    
+    _request.held = true;
+    heldRequests.push_back(&_request);
+    
+    const std::chrono::steady_clock::time_point due = _request.lastSent + _request.minInterval;
+    if(due <= std::chrono::steady_clock::now()) scheduleFlush();
+    else if(flushMode != FlushMode::Manual) net::post(strand, [this, due]{ armCoalesceTimer(due); });
+    
+    return true;
+}
+
+void ObsMessageHandler::releaseCoalesced()
+{
+    //sendMutex is held, called from flushQueue on the io thread
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point nextDue = std::chrono::steady_clock::time_point::max();
+    
+    for(std::size_t i = 0; i < heldRequests.size();)
+    {
+        CoalescedRequest& request = *heldRequests[i];
+        const std::chrono::steady_clock::time_point due = request.lastSent + request.minInterval;
+        if(due > now)
+        {
+            nextDue = std::min(nextDue, due);
+            ++i;
+            continue;
+        }
+        
+        //registered only now, so the timeout runs from when it goes out
+        ResponseCallback callback;
+        if(request.waiters.size() == 1)
+        {
+            callback = std::move(request.waiters.front());
+        }
+        else
+        {
+            std::shared_ptr<std::vector<ResponseCallback>> waiters = std::make_shared<std::vector<ResponseCallback>>(std::move(request.waiters));
+            callback = [waiters](const ObsMessage& _response, std::exception_ptr _error)
+            {
+                for(ResponseCallback& waiter : *waiters) waiter(_response, _error);
+            };
+        }
+        request.waiters.clear();
+        
+        const std::size_t requestTypeSize = std::strlen(request.requestType);
+        const uint64_t messageId = registerRequest(request.requestType, requestTypeSize, callback, std::chrono::milliseconds(0));
+        char messageIdString[20];
+        const std::size_t messageIdSize = writeDecimal(messageIdString, messageId);
+        
+        JsonFrameWriter json(queuedFrames);
+        json.field("request-type", request.requestType, requestTypeSize);
+        json.field("message-id", messageIdString, messageIdSize);
+        if(std::strcmp(request.requestType, "SetCurrentScene") == 0)
+        {
+            json.field("scene-name", request.sceneName);
+        }
+        else
+        {
+            const ItemTransform& transform = request.transform;
+            json.field("item", request.item);
+            if(request.sceneName != "NULL")     json.field("scene-name", request.sceneName);
+            if(request.itemName != "NULL")      json.field("item.name", request.itemName);
+            if(request.itemId != -5)            json.field("item.id", request.itemId);
+            writeTransformFields(json, transform.position, transform.rotation, transform.scale, transform.crop, transform.visible, transform.locked, transform.bounds);
+        }
+        json.finish(maskGenerator());
+        
+        request.transform = ItemTransform();
+        request.itemName = "NULL";
+        request.itemId = -5;
+        request.lastSent = now;
+        request.held = false;
+        heldRequests[i] = heldRequests.back();
+        heldRequests.pop_back();
+    }
+    
+    if(nextDue != std::chrono::steady_clock::time_point::max() && flushMode != FlushMode::Manual) armCoalesceTimer(nextDue);
+}
+
+void ObsMessageHandler::armCoalesceTimer(std::chrono::steady_clock::time_point _due)
+{
+    if(stopped || (coalesceTimerArmed && coalesceDeadline <= _due)) return;
+    coalesceTimerArmed = true;
+    coalesceDeadline = _due;
+    
+    //moving the expiry aborts the earlier wait, only the live one clears the flag
+    coalesceTimer.expires_at(_due);
+    coalesceTimer.async_wait([this](beast::error_code _error)
+    {
+        if(_error) return;
+        coalesceTimerArmed = false;
+        flushQueue();
+    });
+}
+
+/* -------------------------------------------------------------- scene cache ------------------------------------------------------------------------------------------------------------   */
+
+const CachedScene* SceneState::findScene(const std::string& _name) const
+{
+    for(const std::shared_ptr<const CachedScene>& scene : scenes) if(scene->name == _name) return scene.get();
+    return nullptr;
+}
+
+static std::shared_ptr<const CachedScene> cacheScene(const Scene& _scene)
+{
+    std::shared_ptr<CachedScene> scene = std::make_shared<CachedScene>();
+    scene->name = _scene.name.str();
+    scene->items.reserve(_scene.sources.size());
+    
+    for(const SceneItem& source : _scene.sources)
+    {
+        CachedSceneItem item;
+        item.name = source.name.str();
+        item.id = source.id;
+        item.type = source.type.str();
+        item.x = source.x;
+        item.y = source.y;
+        item.cx = source.cx;
+        item.cy = source.cy;
+        item.alignment = source.alignment;
+        item.render = source.render;
+        item.locked = source.locked;
+        scene->items.push_back(std::move(item));
+    }
+    
+    return scene;
+}
+
+void ObsMessageHandler::enableSceneCache(bool _enable)
+{
+    if(sceneCacheEnabled.exchange(_enable) == _enable) return;
+    
+    if(!_enable)
+    {
+        std::vector<uint64_t> handlers;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            handlers.swap(sceneCacheHandlers);
+        }
+        
+        for(uint64_t handler : handlers) removeEventHandler(handler);
+        net::post(strand, [this]{ invalidateSceneState(false); });
+        return;
+    }
+    
+    static const ObsEventType sceneEvents[] = {
+        ObsEventType::SwitchScenes,
+        ObsEventType::ScenesChanged,
+        ObsEventType::SceneCollectionChanged,
+        ObsEventType::SourceRenamed,
+        ObsEventType::SceneItemAdded,
+        ObsEventType::SceneItemRemoved
+    };
+    
+    std::vector<uint64_t> handlers;
+    for(ObsEventType type : sceneEvents)
+    {
+        handlers.push_back(onEvent(type, [this, type](const ObsMessage& _event){ applySceneEvent(type, _event); }));
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        sceneCacheHandlers = handlers;
+    }
+    
+    resyncSceneState();
+}
+
+std::shared_ptr<const SceneState> ObsMessageHandler::sceneState() const
+{
+    return std::atomic_load(&sceneStateSnapshot);
+}
+
+void ObsMessageHandler::resyncSceneState()
+{
+    sceneResyncPending = true;
+    
+    //the response is ordered with the events on the socket: anything before it is already part of
+    //the list, anything after it is applied on top
+    sendRequest(ConstantRequest::GetSceneList, [this](const ObsMessage& _response, std::exception_ptr _error)
+    {
+        sceneResyncPending = false;
+        if(!sceneCacheEnabled) return;
+        
+        Decoded<SceneList> decoded{ResponseArena(_response.size() * 2), SceneList()};
+        std::string error;
+        if(_error || !decodeResponse(_response, decoded.arena, decoded.value, error))
+        {
+            //the old state stays readable, marked stale, until a resync gets through
+            invalidateSceneState(false);
+            return;
+        }
+        
+        std::shared_ptr<SceneState> state = std::make_shared<SceneState>();
+        state->currentScene = decoded->currentScene.str();
+        for(const Scene& scene : decoded->scenes) state->scenes.push_back(cacheScene(scene));
+        state->stale = false;
+        state->syncedAt = std::chrono::steady_clock::now();
+        publishSceneState(state);
+    });
+}
+
+void ObsMessageHandler::publishSceneState(std::shared_ptr<SceneState> _state)
+{
+    //io thread only, so the version can't race
+    _state->version = std::atomic_load(&sceneStateSnapshot)->version + 1;
+    std::atomic_store(&sceneStateSnapshot, std::shared_ptr<const SceneState>(std::move(_state)));
+}
+
+void ObsMessageHandler::invalidateSceneState(bool _resync)
+{
+    const std::shared_ptr<const SceneState> current = std::atomic_load(&sceneStateSnapshot);
+    if(!current->stale)
+    {
+        std::shared_ptr<SceneState> state = std::make_shared<SceneState>(*current);
+        state->stale = true;
+        publishSceneState(state);
+    }
+    
+    if(_resync && sceneCacheEnabled && !sceneResyncPending) resyncSceneState();
+}
+
+void ObsMessageHandler::applySceneEvent(ObsEventType _type, const ObsMessage& _event)
+{
+    if(!sceneCacheEnabled) return;
+    
+    //copies the list of scenes, not the scenes themselves, only the ones that change are replaced
+    std::shared_ptr<SceneState> state = std::make_shared<SceneState>(*std::atomic_load(&sceneStateSnapshot));
+    
+    switch(_type)
+    {
+        case ObsEventType::SwitchScenes:
+        {
+            if(!_event.getString("scene-name", state->currentScene) || !state->findScene(state->currentScene)) return invalidateSceneState(true);
+            break;
+        }
+        case ObsEventType::ScenesChanged:
+        {
+            //4.9 and later send the new list along, older versions need a round trip
+            ResponseArena arena(_event.size() * 2);
+            ArenaArray<Scene> scenes;
+            bool found = false;
+            
+            const bool decoded = forEachMember(_event.data(), _event.data() + _event.size(), [&](const char* _key, std::size_t _keySize, const char* _value, std::size_t _valueSize)
+            {
+                if(!keyIs(_key, _keySize, "scenes")) return true;
+                found = true;
+                return decodeValue(_value, _valueSize, arena, scenes);
+            });
+            if(!decoded || !found) return invalidateSceneState(true);
+            
+            state->scenes.clear();
+            for(const Scene& scene : scenes) state->scenes.push_back(cacheScene(scene));
+            break;
+        }
+        case ObsEventType::SceneCollectionChanged:
+        {
+            //every scene changes at once, not worth patching
+            return invalidateSceneState(true);
+        }
+        case ObsEventType::SourceRenamed:
+        {
+            std::string previousName, newName, sourceType;
+            if(!_event.getString("previousName", previousName) || !_event.getString("newName", newName)) return invalidateSceneState(true);
+            _event.getString("sourceType", sourceType);
+            
+            const bool isScene = sourceType == "scene";
+            if(isScene && state->currentScene == previousName) state->currentScene = newName;
+            
+            //scenes can be items of other scenes too, so the items are checked either way
+            for(std::shared_ptr<const CachedScene>& scene : state->scenes)
+            {
+                const bool renameScene = isScene && scene->name == previousName;
+                const bool renameItems = std::any_of(scene->items.begin(), scene->items.end(), [&](const CachedSceneItem& _item){ return _item.name == previousName; });
+                if(!renameScene && !renameItems) continue;
+                
+                std::shared_ptr<CachedScene> renamed = std::make_shared<CachedScene>(*scene);
+                if(renameScene) renamed->name = newName;
+                for(CachedSceneItem& item : renamed->items) if(item.name == previousName) item.name = newName;
+                scene = renamed;
+            }
+            break;
+        }
+        case ObsEventType::SceneItemAdded:
+        case ObsEventType::SceneItemRemoved:
+        {
+            std::string sceneName, itemName;
+            int64_t itemId = 0;
+            if(!_event.getString("scene-name", sceneName) || !_event.getString("item-name", itemName) || !_event.getInt("item-id", itemId)) return invalidateSceneState(true);
+            
+            auto scene = std::find_if(state->scenes.begin(), state->scenes.end(), [&](const std::shared_ptr<const CachedScene>& _scene){ return _scene->name == sceneName; });
+            if(scene == state->scenes.end()) return invalidateSceneState(true);
+            
+            std::shared_ptr<CachedScene> changed = std::make_shared<CachedScene>(**scene);
+            if(_type == ObsEventType::SceneItemAdded)
+            {
+                //the event only names the item, the rest arrives with the next resync
+                CachedSceneItem item;
+                item.name = itemName;
+                item.id = itemId;
+                item.render = true;
+                changed->items.push_back(std::move(item));
+            }
+            else
+            {
+                auto item = std::find_if(changed->items.begin(), changed->items.end(), [itemId](const CachedSceneItem& _item){ return _item.id == itemId; });
+                if(item == changed->items.end()) return invalidateSceneState(true);
+                changed->items.erase(item);
+            }
+            
+            *scene = changed;
+            break;
+        }
+        default:
+            return;
+    }
+    
+    publishSceneState(state);
+}
+
+/* -------------------------------------------------------------- transform cache --------------------------------------------------------------------------------------------------------   */
+
+void ObsMessageHandler::enableTransformCache(bool _enable)
+{
+    if(transformCacheEnabled.exchange(_enable) == _enable) return;
+    
+    if(!_enable)
+    {
+        std::vector<uint64_t> handlers;
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            handlers.swap(transformCacheHandlers);
+        }
+        
+        for(uint64_t handler : handlers) removeEventHandler(handler);
+        
+        std::lock_guard<std::mutex> lock(transformMutex);
+        itemTransforms.clear();
+        return;
+    }
+    
+    static const ObsEventType transformEvents[] = {
+        ObsEventType::SceneItemTransformChanged,
+        ObsEventType::SceneItemVisibilityChanged,
+        ObsEventType::SceneItemLockChanged,
+        ObsEventType::SceneItemRemoved,
+        ObsEventType::SourceRenamed,
+        ObsEventType::ScenesChanged,
+        ObsEventType::SceneCollectionChanged
+    };
+    
+    std::vector<uint64_t> handlers;
+    for(ObsEventType type : transformEvents)
+    {
+        handlers.push_back(onEvent(type, [this, type](const ObsMessage& _event){ applyTransformEvent(type, _event); }));
+    }
+    
+    std::lock_guard<std::mutex> lock(stateMutex);
+    transformCacheHandlers = handlers;
+}
+
+//clears _value when OBS already has it, otherwise records it as the new state
+template<class T>
+static bool keepIfChanged(T& _value, T& _cached, const T& _unset)
+{
+    if(_value == _unset) return false;
+    
+    if(_value == _cached)
+    {
+        _value = _unset;
+        return false;
+    }
+    
+    _cached = _value;
+    return true;
+}
+
+bool ObsMessageHandler::applyTransformDelta(const std::string& _sceneName, const std::string& _item, ItemPosition& _position, double& _rotation, Scale& _scale, Crop& _crop, int& _visible, int& _locked, ItemBounds& _bounds)
+{
+    //transformMutex is held
+    transformKey.assign(_sceneName);
+    transformKey.push_back('\0');
+    transformKey.append(_item);
+    ItemTransform& cached = itemTransforms[transformKey];
+    
+    const std::string unsetType = "NULL";
+    bool changed = false;
+    
+    changed |= keepIfChanged(_position.x, cached.position.x, -5.0);
+    changed |= keepIfChanged(_position.y, cached.position.y, -5.0);
+    changed |= keepIfChanged(_position.alignment, cached.position.alignment, -5);
+    changed |= keepIfChanged(_rotation, cached.rotation, -5.0);
+    changed |= keepIfChanged(_scale.x, cached.scale.x, -5.0);
+    changed |= keepIfChanged(_scale.y, cached.scale.y, -5.0);
+    changed |= keepIfChanged(_crop.top, cached.crop.top, -5);
+    changed |= keepIfChanged(_crop.bottom, cached.crop.bottom, -5);
+    changed |= keepIfChanged(_crop.left, cached.crop.left, -5);
+    changed |= keepIfChanged(_crop.right, cached.crop.right, -5);
+    changed |= keepIfChanged(_visible, cached.visible, -1);
+    changed |= keepIfChanged(_locked, cached.locked, -1);
+    changed |= keepIfChanged(_bounds.type, cached.bounds.type, unsetType);
+    changed |= keepIfChanged(_bounds.alignment, cached.bounds.alignment, -5);
+    changed |= keepIfChanged(_bounds.x, cached.bounds.x, -5.0);
+    changed |= keepIfChanged(_bounds.y, cached.bounds.y, -5.0);
+    
+    return changed;
+}
+
+void ObsMessageHandler::forgetTransform(const std::string& _sceneName, const std::string& _item)
+{
+    std::lock_guard<std::mutex> lock(transformMutex);
+    transformKey.assign(_sceneName);
+    transformKey.push_back('\0');
+    transformKey.append(_item);
+    itemTransforms.erase(transformKey);
+}
+
+void ObsMessageHandler::applyTransformEvent(ObsEventType _type, const ObsMessage& _event)
+{
+    if(!transformCacheEnabled) return;
+    
+    if(_type == ObsEventType::SourceRenamed || _type == ObsEventType::ScenesChanged || _type == ObsEventType::SceneCollectionChanged)
+    {
+        //names moved around, starting over is cheaper than chasing them
+        std::lock_guard<std::mutex> lock(transformMutex);
+        itemTransforms.clear();
+        return;
+    }
+    
+    std::string sceneName, itemName;
+    if(!_event.getString("scene-name", sceneName) || !_event.getString("item-name", itemName)) return;
+    
+    if(_type == ObsEventType::SceneItemRemoved) return forgetTransform(sceneName, itemName);
+    
+    SceneItemProperties transform;
+    bool flag = false;
+    
+    if(_type == ObsEventType::SceneItemTransformChanged)
+    {
+        //same shape as a GetSceneItemProperties response
+        ResponseArena arena;
+        bool found = false;
+        const bool decoded = forEachMember(_event.data(), _event.data() + _event.size(), [&](const char* _key, std::size_t _keySize, const char* _value, std::size_t _valueSize)
+        {
+            if(!keyIs(_key, _keySize, "transform")) return true;
+            found = true;
+            return decodeValue(_value, _valueSize, arena, transform);
+        });
+        
+        if(!decoded || !found) return forgetTransform(sceneName, itemName);
+    }
+    else if(!_event.getBool(_type == ObsEventType::SceneItemVisibilityChanged ? "item-visible" : "item-locked", flag))
+    {
+        return forgetTransform(sceneName, itemName);
+    }
+    
+    std::lock_guard<std::mutex> lock(transformMutex);
+    ItemTransform& cached = itemTransforms[sceneName + '\0' + itemName];
+    
+    if(_type == ObsEventType::SceneItemVisibilityChanged)
+    {
+        cached.visible = flag;
+    }
+    else if(_type == ObsEventType::SceneItemLockChanged)
+    {
+        cached.locked = flag;
+    }
+    else
+    {
+        cached.position = transform.position;
+        cached.rotation = transform.rotation;
+        cached.scale = transform.scale;
+        cached.crop = transform.crop;
+        cached.visible = transform.visible;
+        cached.locked = transform.locked;
+        cached.bounds = transform.bounds;
+    }
+}
+
+/* -------------------------------------------------------------- animation --------------------------------------------------------------------------------------------------------------   */
+
+static double ease(Easing _easing, double _t)
+{
+    //M_PI is not standard C++
+    constexpr double pi = 3.14159265358979323846;
+    
+    switch(_easing)
+    {
+        case Easing::Linear:            return _t;
+        case Easing::EaseInQuad:        return _t * _t;
+        case Easing::EaseOutQuad:       return _t * (2 - _t);
+        case Easing::EaseInOutQuad:     return _t < 0.5 ? 2 * _t * _t : 1 - 2 * (1 - _t) * (1 - _t);
+        case Easing::EaseInCubic:       return _t * _t * _t;
+        case Easing::EaseOutCubic:      return 1 - (1 - _t) * (1 - _t) * (1 - _t);
+        case Easing::EaseInOutCubic:    return _t < 0.5 ? 4 * _t * _t * _t : 1 - 4 * (1 - _t) * (1 - _t) * (1 - _t);
+        case Easing::EaseInOutSine:     return (1 - std::cos(pi * _t)) / 2;
+    }
+    return _t;
+}
+
+//a thousandth of a pixel or degree is well below what OBS can show, rounding to it keeps the frames short,
+//lets them be written without printf and gives the transform cache identical values to compare
+static const unsigned tweenDecimals = 3;
+
+static double tweenValue(double _from, double _to, double _eased)
+{
+    if(_eased >= 1) return _to;
+    return std::round((_from + (_to - _from) * _eased) * 1000) / 1000;
+}
+
+//fills the animated fields of _transform that are unset but set in _source
+static void fillUnset(ItemTransform& _transform, const ItemTransform& _source)
+{
+    if(_transform.position.x == -5)     _transform.position.x = _source.position.x;
+    if(_transform.position.y == -5)     _transform.position.y = _source.position.y;
+    if(_transform.rotation == -5)       _transform.rotation = _source.rotation;
+    if(_transform.scale.x == -5)        _transform.scale.x = _source.scale.x;
+    if(_transform.scale.y == -5)        _transform.scale.y = _source.scale.y;
+    if(_transform.crop.top == -5)       _transform.crop.top = _source.crop.top;
+    if(_transform.crop.bottom == -5)    _transform.crop.bottom = _source.crop.bottom;
+    if(_transform.crop.left == -5)      _transform.crop.left = _source.crop.left;
+    if(_transform.crop.right == -5)     _transform.crop.right = _source.crop.right;
+}
+
+uint64_t ObsMessageHandler::animate(const std::string& _sceneName, const std::string& _item, ItemTransform _from, const ItemTransform& _to, std::chrono::milliseconds _duration, Easing _easing, std::function<void()> _done)
+{
+    if(transformCacheEnabled)
+    {
+        std::lock_guard<std::mutex> lock(transformMutex);
+        std::unordered_map<std::string, ItemTransform>::const_iterator cached = itemTransforms.find(_sceneName + '\0' + _item);
+        if(cached != itemTransforms.end()) fillUnset(_from, cached->second);
+    }
+    
+    //whatever is still unknown jumps to its target on the first tick
+    fillUnset(_from, _to);
+    
+    Tween tween{0, _sceneName, _item, _from, _to, std::chrono::steady_clock::now(), _duration, _easing, std::move(_done), false};
+    
+    uint64_t animationId;
+    bool idle;
+    {
+        std::lock_guard<std::mutex> lock(animationMutex);
+        animationId = tween.id = nextTweenId++;
+        idle = addedTweens.empty();
+        addedTweens.push_back(std::move(tween));
+    }
+    
+    //a non-empty list means a start or a tick is already on its way to pick this one up
+    if(idle) net::post(strand, [this]{ startAnimating(); });
+    
+    return animationId;
+}
+
+void ObsMessageHandler::cancelAnimation(uint64_t _animationId)
+{
+    std::lock_guard<std::mutex> lock(animationMutex);
+    for(std::size_t i = 0; i < addedTweens.size(); ++i)
+    {
+        if(addedTweens[i].id != _animationId) continue;
+        addedTweens.erase(addedTweens.begin() + i);
+        return;
+    }
+    
+    cancelledTweens.push_back(_animationId);
+}
+
+void ObsMessageHandler::setAnimationRate(double _fps)
+{
+    if(_fps > 0)
+    {
+        const std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / _fps));
+        net::post(strand, [this, period]{ animationPeriod = period; });
+        return;
+    }
+    
+    sendRequest(ConstantRequest::GetVideoInfo, [this](const ObsMessage& _response, std::exception_ptr _error)
+    {
+        ResponseArena arena(_response.size() * 2);
+        VideoInfo info;
+        std::string error;
+        
+        if(_error || !decodeResponse(_response, arena, info, error) || info.fps <= 0)
+        {
+            std::cerr << "Error: could not read the OBS fps, animation rate unchanged" << std::endl;
+            return;
+        }
+        
+        setAnimationRate(info.fps);
+    });
+}
+
+void ObsMessageHandler::startAnimating()
+{
+    if(animating) return;
+    animating = true;
+    nextAnimationTick = std::chrono::steady_clock::now();
+    onAnimationTick();
+}
+
+void ObsMessageHandler::onAnimationTick()
+{
+    {
+        std::lock_guard<std::mutex> lock(animationMutex);
+        
+        for(Tween& added : addedTweens)
+        {
+            //one tween per item, the newer one takes over
+            std::size_t i = 0;
+            while(i < tweens.size() && (tweens[i].item != added.item || tweens[i].sceneName != added.sceneName)) ++i;
+            
+            if(i < tweens.size()) tweens[i] = std::move(added);
+            else tweens.push_back(std::move(added));
+        }
+        addedTweens.clear();
+        
+        for(uint64_t cancelled : cancelledTweens)
+        {
+            for(std::size_t i = 0; i < tweens.size(); ++i)
+            {
+                if(tweens[i].id != cancelled) continue;
+                tweens[i] = std::move(tweens.back());
+                tweens.pop_back();
+                break;
+            }
+        }
+        cancelledTweens.clear();
+        
+        if(tweens.empty() || stopped)
+        {
+            animating = false;
+            return;
+        }
+    }
+    
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    
+    {
+        //same lock order as r_SetSceneItemProperties, every frame of the tick is queued before the flush goes out
+        std::unique_lock<std::mutex> transformLock(transformMutex, std::defer_lock);
+        if(transformCacheEnabled) transformLock.lock();
+        
+        std::lock_guard<std::mutex> lock(sendMutex);
+        for(Tween& tween : tweens) writeTweenFrame(tween, now);
+        scheduleFlush();
+    }
+    
+    for(std::size_t i = 0; i < tweens.size();)
+    {
+        if(!tweens[i].finished)
+        {
+            ++i;
+            continue;
+        }
+        
+        if(tweens[i].done) finishedTweens.push_back(std::move(tweens[i].done));
+        tweens[i] = std::move(tweens.back());
+        tweens.pop_back();
+    }
+    
+    //called without any lock held, they may well start the next animation
+    for(std::function<void()>& done : finishedTweens) done();
+    finishedTweens.clear();
+    
+    //ticks stay on the grid, a late tick drops the ones it missed instead of bursting to catch up
+    nextAnimationTick += animationPeriod;
+    if(nextAnimationTick <= now) nextAnimationTick = now + animationPeriod;
+    
+    animationTimer.expires_at(nextAnimationTick);
+    animationTimer.async_wait([this](beast::error_code _error)
+    {
+        if(_error) animating = false;
+        else onAnimationTick();
+    });
+}
+
+void ObsMessageHandler::writeTweenFrame(Tween& _tween, std::chrono::steady_clock::time_point _now)
+{
+    //sendMutex is held, and transformMutex when the transform cache is on
+    double progress = 1;
+    if(_tween.duration.count() > 0 && _now < _tween.start + _tween.duration)
+    {
+        progress = std::chrono::duration<double>(_now - _tween.start) / _tween.duration;
+    }
+    
+    _tween.finished = progress >= 1;
+    
+    //the clock keeps running while the connection is down, the first tick after it's back jumps to where the tween is by then
+    if(!sessionOpen) return;
+    
+    const double eased = _tween.finished ? 1 : ease(_tween.easing, progress);
+    
+    const ItemTransform& from = _tween.from;
+    const ItemTransform& to = _tween.to;
+    ItemTransform current;
+    
+    if(to.position.x != -5)     current.position.x = tweenValue(from.position.x, to.position.x, eased);
+    if(to.position.y != -5)     current.position.y = tweenValue(from.position.y, to.position.y, eased);
+    if(to.rotation != -5)       current.rotation = tweenValue(from.rotation, to.rotation, eased);
+    if(to.scale.x != -5)        current.scale.x = tweenValue(from.scale.x, to.scale.x, eased);
+    if(to.scale.y != -5)        current.scale.y = tweenValue(from.scale.y, to.scale.y, eased);
+    if(to.crop.top != -5)       current.crop.top = static_cast<int>(std::lround(from.crop.top + (to.crop.top - from.crop.top) * eased));
+    if(to.crop.bottom != -5)    current.crop.bottom = static_cast<int>(std::lround(from.crop.bottom + (to.crop.bottom - from.crop.bottom) * eased));
+    if(to.crop.left != -5)      current.crop.left = static_cast<int>(std::lround(from.crop.left + (to.crop.left - from.crop.left) * eased));
+    if(to.crop.right != -5)     current.crop.right = static_cast<int>(std::lround(from.crop.right + (to.crop.right - from.crop.right) * eased));
+    
+    //with the cache on only what moved since the last tick goes out, a crop that rounds to the same pixels sends nothing
+    if(transformCacheEnabled && !applyTransformDelta(_tween.sceneName, _tween.item, current.position, current.rotation, current.scale, current.crop, current.visible, current.locked, current.bounds)) return;
+    
+    //nobody waits for these, but like any other setter a frame OBS refuses or never answers means the
+    //cache no longer matches, so the next frame sends every field again
+    ResponseCallback callback = [this, sceneName = _tween.sceneName, item = _tween.item](const ObsMessage& _response, std::exception_ptr _error)
+    {
+        std::string status;
+        if(_error || (_response.getString("status", status) && status == "error")) forgetTransform(sceneName, item);
+    };
+    
+    const uint64_t messageId = registerRequest("SetSceneItemProperties", 22, callback, std::chrono::milliseconds(0));
+    char messageIdString[20];
+    const std::size_t messageIdSize = writeDecimal(messageIdString, messageId);
+    
+    JsonFrameWriter json(queuedFrames);
+    json.field("request-type", "SetSceneItemProperties", 22);
+    json.field("message-id", messageIdString, messageIdSize);
+    json.field("scene-name", _tween.sceneName);
+    json.field("item", _tween.item);
+    if(current.position.x != -5)    json.field("position.x", current.position.x, tweenDecimals);
+    if(current.position.y != -5)    json.field("position.y", current.position.y, tweenDecimals);
+    if(current.rotation != -5)      json.field("rotation", current.rotation, tweenDecimals);
+    if(current.scale.x != -5)       json.field("scale.x", current.scale.x, tweenDecimals);
+    if(current.scale.y != -5)       json.field("scale.y", current.scale.y, tweenDecimals);
+    if(current.crop.top != -5)      json.field("crop.top", current.crop.top);
+    if(current.crop.bottom != -5)   json.field("crop.bottom", current.crop.bottom);
+    if(current.crop.left != -5)     json.field("crop.left", current.crop.left);
+    if(current.crop.right != -5)    json.field("crop.right", current.crop.right);
+    json.finish(maskGenerator());
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetVersion()
+{
+    return sendRequest(ConstantRequest::GetVersion);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetAuthRequired()
+{
+    return sendRequest(ConstantRequest::GetAuthRequired);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_Authenticate(std::string& _challenge, std::string& _salt, std::string& _password)
+{
+    const std::string auth_response = authResponse(_password, _salt, _challenge);
+    
+    return sendFields("Authenticate", [&](JsonFrameWriter& _json)
+    {
+        _json.field("auth", auth_response);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SetHeartbeat(bool _enable)
+{
+    //replayed when a session is reopened
+    heartbeat = _enable ? 1 : 0;
+    
+    return sendFields("SetHeartbeat", [&](JsonFrameWriter& _json)
+    {
+        _json.field("enable", _enable);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SetFilenameFormatting(std::string& _format)
+{
+    return sendFields("SetFilenameFormatting", [&](JsonFrameWriter& _json)
+    {
+        _json.field("filename-formatting", _format);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetFilenameFormatting()
+{
+    return sendRequest(ConstantRequest::GetFilenameFormatting);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetStats()
+{
+    return sendRequest(ConstantRequest::GetStats);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_BroadcastCustomMessage(std::string _realm, Json::Value& _object)
+{
+    return sendFields("BroadcastCustomMessage", [&](JsonFrameWriter& _json)
+    {
+        _json.field("realm", _realm);
+        _json.field("data", _object);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetVideoInfo()
+{
+    return sendRequest(ConstantRequest::GetVideoInfo);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_OpenProjector(std::string _type = "NULL", int _monitor = -5, int _x = -5, int _y = -5, int _width = -5, int _height = -5, std::string _name = "NULL")
+{
+    //not tested
+    std::string geometry = base64_encode(std::to_string(_x) + "," + std::to_string(_y) + "," + std::to_string(_width) + "," + std::to_string(_height));
+    
+    return sendFields("OpenProjector", [&](JsonFrameWriter& _json)
+    {
+        if(_type != "NULL") _json.field("type", _type);
+        if(_monitor != -5) _json.field("monitor", _monitor);
+        if(_x != -5 || _y != -5 || _width != -5 || _height != -5) _json.field("geometry", geometry);
+        if(_name != "NULL") _json.field("name", _name);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_ListOutputs()
+{
+    return sendRequest(ConstantRequest::ListOutputs);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetOutputInfo(std::string& _outputName)
+{
+    return sendFields("GetOutputInfo", [&](JsonFrameWriter& _json)
+    {
+        _json.field("outputName", _outputName);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StartOutput(std::string& _outputName)
+{
+    return sendFields("StartOutput", [&](JsonFrameWriter& _json)
+    {
+        _json.field("outputName", _outputName);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StopOutput(std::string& _outputName, bool _force)
+{
+    return sendFields("StopOutput", [&](JsonFrameWriter& _json)
+    {
+        _json.field("outputName", _outputName);
+        _json.field("force", _force);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SetCurrentProfile(std::string& _profileName)
+{
+    return sendFields("SetCurrentProfile", [&](JsonFrameWriter& _json)
+    {
+        _json.field("profile-name", _profileName);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetCurrentProfile()
+{
+    return sendRequest(ConstantRequest::GetCurrentProfile);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_ListProfiles()
+{
+    return sendRequest(ConstantRequest::ListProfiles);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StartStopRecording()
+{
+    return sendRequest(ConstantRequest::StartStopRecording);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StartRecording()
+{
+    return sendRequest(ConstantRequest::StartRecording);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StopRecording()
+{
+    return sendRequest(ConstantRequest::StopRecording);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_PauseRecording()
+{
+    return sendRequest(ConstantRequest::PauseRecording);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_ResumeRecording()
+{
+    return sendRequest(ConstantRequest::ResumeRecording);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SetRecordingFolder(std::string& _recFolder)
+{
+    return sendFields("SetRecordingFolder", [&](JsonFrameWriter& _json)
+    {
+        _json.field("rec-folder", _recFolder);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetRecordingFolder()
+{
+    return sendRequest(ConstantRequest::GetRecordingFolder);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StartStopReplayBufer()
+{
+    return sendRequest(ConstantRequest::StartStopReplayBuffer);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StartReplayBuffer()
+{
+    return sendRequest(ConstantRequest::StartReplayBuffer);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_StopReplayBuffer()
+{
+    return sendRequest(ConstantRequest::StopReplayBuffer);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SaveReplayBuffer()
+{
+    return sendRequest(ConstantRequest::SaveReplayBuffer);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SetCurrentSceneCollection(std::string& _scName)
+{
+    return sendFields("SetCurrentSceneCollection", [&](JsonFrameWriter& _json)
+    {
+        _json.field("sc-name", _scName);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetCurrentSceneCollection()
+{
+    return sendRequest(ConstantRequest::GetCurrentSceneCollection);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_ListSceneCollections()
+{
+    return sendRequest(ConstantRequest::ListSceneCollections);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetSceneItemProperties(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5)
+{
+    //add different function if item = object
+    return sendFields("GetSceneItemProperties", [&](JsonFrameWriter& _json)
+    {
+        if(_sceneName != "NULL") _json.field("scene-name", _sceneName);
+        _json.field("item", _item);
+        if(_itemName != "NULL") _json.field("item.name", _itemName);
+        if(_itemId != -5) _json.field("item.id", _itemId);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SetSceneItemProperties(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5, Position _position = {-5, -5, -5}, double _rotation = -5, Scale _scale = {-5, -5}, Crop _crop = {-5, -5, -5, -5}, int _visible = -1, int _locked = -1, Bounds _bounds = {"NULL", -5, -5, -5})
+{
+    //the cache and held transforms use OBS's fractional positions, -5 stays -5
+    ItemPosition position;
+    position.x = _position.x;
+    position.y = _position.y;
+    position.alignment = _position.alignment;
+    ItemBounds bounds;
+    bounds.type = _bounds.type;
+    bounds.alignment = _bounds.alignment;
+    bounds.x = _bounds.x;
+    bounds.y = _bounds.y;
+    
+    const bool cached = transformCacheEnabled && _sceneName != "NULL";
+    
+    //held until the frame is queued or merged, so the cache and the wire agree on the order of concurrent updates
+    std::unique_lock<std::mutex> transformLock(transformMutex, std::defer_lock);
+    if(cached)
+    {
+        transformLock.lock();
+        if(!applyTransformDelta(_sceneName, _item, position, _rotation, _scale, _crop, _visible, _locked, bounds))
+        {
+            //OBS already has all of it
+            std::promise<Json::Value> skipped;
+            Json::Value response;
+            response["status"] = "ok";
+            skipped.set_value(response);
+            return skipped.get_future();
+        }
+    }
+    
+    std::shared_ptr<std::promise<Json::Value>> promise = std::make_shared<std::promise<Json::Value>>();
+    std::future<Json::Value> future = promise->get_future();
+    
+    ResponseCallback callback;
+    if(!cached)
+    {
+        callback = promiseCallback(promise);
+    }
+    else
+    {
+        callback = [this, promise, _sceneName, _item](const ObsMessage& _response, std::exception_ptr _error)
+        {
+            //the cache already holds what was sent, if OBS didn't take it the item is unknown again. A refused
+            //request fails while transformMutex is still held, and there is no connection left to match then
+            std::string status;
+            if(_error ? !refusingRequests() : (_response.getString("status", status) && status == "error")) forgetTransform(_sceneName, _item);
+            
+            if(_error) promise->set_exception(_error);
+            else promise->set_value(_response.json());
+        };
+    }
+    
+    if(coalescingEnabled)
+    {
+        std::unique_lock<std::mutex> lock(sendMutex);
+        CoalescedRequest& request = coalescedRequest("SetSceneItemProperties", _sceneName, _item);
+        ItemTransform& held = request.transform;
+        
+        takeIfSet(request.itemName, _itemName, std::string("NULL"));
+        takeIfSet(request.itemId, _itemId, -5);
+        takeIfSet(held.position.x, position.x, -5.0);
+        takeIfSet(held.position.y, position.y, -5.0);
+        takeIfSet(held.position.alignment, position.alignment, -5);
+        takeIfSet(held.rotation, _rotation, -5.0);
+        takeIfSet(held.scale.x, _scale.x, -5.0);
+        takeIfSet(held.scale.y, _scale.y, -5.0);
+        takeIfSet(held.crop.top, _crop.top, -5);
+        takeIfSet(held.crop.bottom, _crop.bottom, -5);
+        takeIfSet(held.crop.left, _crop.left, -5);
+        takeIfSet(held.crop.right, _crop.right, -5);
+        takeIfSet(held.visible, _visible, -1);
+        takeIfSet(held.locked, _locked, -1);
+        takeIfSet(held.bounds.type, bounds.type, std::string("NULL"));
+        takeIfSet(held.bounds.alignment, bounds.alignment, -5);
+        takeIfSet(held.bounds.x, bounds.x, -5.0);
+        takeIfSet(held.bounds.y, bounds.y, -5.0);
+        
+        if(holdCoalesced(request, callback)) return future;
+        
+        lock.unlock();
+        callback(ObsMessage(), notConnected());
+        return future;
+    }
+    
+    sendFields("SetSceneItemProperties", std::move(callback), std::chrono::milliseconds(0), [&](JsonFrameWriter& _json)
+    {
+        _json.field("item", _item);
+        if(_sceneName != "NULL")        _json.field("scene-name", _sceneName);
+        if(_itemName != "NULL")         _json.field("item.name", _itemName);
+        if(_itemId != -5)               _json.field("item.id", _itemId);
+        writeTransformFields(_json, position, _rotation, _scale, _crop, _visible, _locked, bounds);
+    });
+    
+    return future;
+}
+
+std::future<Json::Value> ObsMessageHandler::r_ResetSceneItem(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5)
+{
+    return sendFields("ResetSceneItem", [&](JsonFrameWriter& _json)
+    {
+        _json.field("item", _item);
+        if(_sceneName != "NULL")        _json.field("scene-name", _sceneName);
+        if(_itemName != "NULL")         _json.field("item.name", _itemName);
+        if(_itemId != -5)               _json.field("item.id", _itemId);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_DeleteSceneItem(std::string _item, std::string _sceneName = "NULL", std::string _itemName = "NULL", int _itemId = -5)
+{
+    return sendFields("DeleteSceneItem", [&](JsonFrameWriter& _json)
+    {
+        _json.field("item", _item);
+        if(_sceneName != "NULL")        _json.field("scene-name", _sceneName);
+        if(_itemName != "NULL")         _json.field("item.name", _itemName);
+        if(_itemId != -5)               _json.field("item.id", _itemId);
+    });
+}
+
+void ObsMessageHandler::r_DuplicateSceneItem()
+{
+    //Not yet implimented
+    std::cout << "NOT YET IMPLIMENTED" << std::endl;
+}
+
+std::future<Json::Value> ObsMessageHandler::r_SetCurrentScene(std::string& _sceneName)
+{
+    if(coalescingEnabled)
+    {
+        std::shared_ptr<std::promise<Json::Value>> promise = std::make_shared<std::promise<Json::Value>>();
+        std::future<Json::Value> future = promise->get_future();
+        
+        //one key for the whole request type, only the last scene asked for matters
+        ResponseCallback callback = promiseCallback(promise);
+        std::unique_lock<std::mutex> lock(sendMutex);
+        CoalescedRequest& request = coalescedRequest("SetCurrentScene", std::string(), std::string());
+        request.sceneName = _sceneName;
+        if(holdCoalesced(request, callback)) return future;
+        
+        lock.unlock();
+        callback(ObsMessage(), notConnected());
+        return future;
+    }
+    
+    return sendFields("SetCurrentScene", [&](JsonFrameWriter& _json)
+    {
+        _json.field("scene-name", _sceneName);
+    });
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetCurrentScene()
+{
+    return sendRequest(ConstantRequest::GetCurrentScene);
+}
+
+std::future<Json::Value> ObsMessageHandler::r_GetSceneList()
+{
+    return sendRequest(ConstantRequest::GetSceneList);
+}
+
+template<class T>
+static ResponseCallback decodingCallback(std::future<Decoded<T>>& _future)
+{
+    std::shared_ptr<std::promise<Decoded<T>>> promise = std::make_shared<std::promise<Decoded<T>>>();
+    _future = promise->get_future();
+    
+    return [promise](const ObsMessage& _response, std::exception_ptr _error)
+    {
+        if(_error)
+        {
+            promise->set_exception(_error);
+            return;
+        }
+        
+        //strings never unescape to more than their raw size and the structs are smaller than the json
+        //they come from, so twice the frame normally holds the whole response
+        Decoded<T> decoded{ResponseArena(_response.size() * 2), T()};
+        std::string error;
+        
+        if(decodeResponse(_response, decoded.arena, decoded.value, error)) promise->set_value(std::move(decoded));
+        else promise->set_exception(std::make_exception_ptr(ObsResponseError(error)));
+    };
+}
+
+std::future<Decoded<SceneList>> ObsMessageHandler::getSceneList()
+{
+    std::future<Decoded<SceneList>> future;
+    sendRequest(ConstantRequest::GetSceneList, decodingCallback(future));
+    return future;
+}
+
+std::future<Decoded<SceneItemProperties>> ObsMessageHandler::getSceneItemProperties(std::string _item, std::string _sceneName, std::string _itemName, int _itemId)
+{
+    std::future<Decoded<SceneItemProperties>> future;
+    sendFields("GetSceneItemProperties", decodingCallback(future), std::chrono::milliseconds(0), [&](JsonFrameWriter& _json)
+    {
+        if(_sceneName != "NULL") _json.field("scene-name", _sceneName);
+        _json.field("item", _item);
+        if(_itemName != "NULL") _json.field("item.name", _itemName);
+        if(_itemId != -5) _json.field("item.id", _itemId);
+    });
+    return future;
+}
+
+std::future<Decoded<OutputList>> ObsMessageHandler::listOutputs()
+{
+    std::future<Decoded<OutputList>> future;
+    sendRequest(ConstantRequest::ListOutputs, decodingCallback(future));
+    return future;
+}
+
+std::future<Decoded<ObsStats>> ObsMessageHandler::getStats()
+{
+    std::future<Decoded<ObsStats>> future;
+    sendRequest(ConstantRequest::GetStats, decodingCallback(future));
+    return future;
+}
+
+std::future<Decoded<VideoInfo>> ObsMessageHandler::getVideoInfo()
+{
+    std::future<Decoded<VideoInfo>> future;
+    sendRequest(ConstantRequest::GetVideoInfo, decodingCallback(future));
+    return future;
+}
+
+void ObsMessageHandler::recieve()
+{
+    recieveUsingThread();
+    
+    std::unique_lock<std::mutex> lock(stateMutex);
+    closedCondition.wait(lock, [this]{ return closed; });
+}
+
+void ObsMessageHandler::recieveUsingThread()
+{
+    //frames are read on the io thread as they arrive, this only has to kick off the first read
+    net::post(strand, [this]
+    {
+        if(reading) return;
+        reading = true;
+        
+        //while reconnecting the read is started again once the session is back
+        if(connected) doRead();
+    });
+}
+
+void ObsMessageHandler::doRead()
+{
+    ws->async_read(readBuffer, [this](beast::error_code _ec, std::size_t)
+    {
+        if(_ec)
+        {
+            //a close we asked for isn't worth reporting
+            if(!stopped && _ec != websocket::error::closed) std::cerr << "Error: " << _ec.message() << std::endl;
+            connected = false;
+            
+            {
+                std::lock_guard<std::mutex> lock(sendMutex);
+                sessionOpen = false;
+            }
+            
+            //events are lost from here on, the mirror can't be trusted anymore
+            if(sceneCacheEnabled) invalidateSceneState(false);
+            if(transformCacheEnabled)
+            {
+                std::lock_guard<std::mutex> lock(transformMutex);
+                itemTransforms.clear();
+            }
+            
+            if(reconnectEnabled && !stopped)
+            {
+                //aborts a write still stuck on the dead connection before the stream is replaced
+                beast::error_code ec;
+                beast::get_lowest_layer(*ws).close(ec);
+                return scheduleReconnect();
+            }
+            
+            refuseRequests();
+            std::lock_guard<std::mutex> lock(stateMutex);
+            closed = true;
+            closedCondition.notify_all();
+            return;
+        }
+        
+        lastMessageAt = std::chrono::steady_clock::now().time_since_epoch().count();
+        
+        try
+        {
+            const net::const_buffer frame = readBuffer.data();
+            handleMessage(static_cast<const char*>(frame.data()), frame.size());
+        }
+        catch(std::exception const& e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        
+        readBuffer.consume(readBuffer.size());
+        doRead();
+    });
+}
+
+void ObsMessageHandler::handleMessage(const char* _data, std::size_t _size)
+{
+    //only the top level is walked here, the handlers decide how much of the rest gets parsed
+    const ObsMessage message(_data, _size, jsonReader.get());
+    if(!message.valid())
+    {
+        std::cerr << "Error: malformed message" << std::endl;
+        return;
+    }
+    
+    // Responses go back to whoever sent the request, updates to the registered event handlers
+    if(message.isResponse()) completeRequest(message);
+    else if(message.isEvent()) dispatchEvent(message);
+}
+
+
+
+/* -------------------------------------------------------------- connection manager -----------------------------------------------------------------------------------------------------   */
+
+ObsConnectionManager::ObsConnectionManager(std::size_t _threads)
+{
+    for(std::size_t i = 0; i < std::max<std::size_t>(_threads, 1); i++) threads.emplace_back([this]{ ioc.run(); });
+}
+
+ObsConnectionManager::~ObsConnectionManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        for(std::unique_ptr<ObsMessageHandler>& handler : handlers) handler->close();
+    }
+    
+    //the pool returns once every connection has shut down and its last handler ran
+    work.reset();
+    for(std::thread& thread : threads) thread.join();
+}
+
+ObsMessageHandler& ObsConnectionManager::add(std::string _host, std::string _port)
+{
+    std::unique_ptr<ObsMessageHandler> handler(new ObsMessageHandler(ioc));
+    handler->connect(_host, _port);
+    if(handler->health().connected) handler->recieveUsingThread();
+    
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    handlers.push_back(std::move(handler));
+    return *handlers.back();
+}
+
+std::vector<ObsMessageHandler*> ObsConnectionManager::connections() const
+{
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    std::vector<ObsMessageHandler*> result;
+    for(const std::unique_ptr<ObsMessageHandler>& handler : handlers) result.push_back(handler.get());
+    return result;
+}
+
+std::vector<std::future<Json::Value>> ObsConnectionManager::broadcast(Json::Value& _request)
+{
+    std::vector<std::shared_ptr<std::promise<Json::Value>>> promises(connections().size());
+    std::vector<std::future<Json::Value>> futures;
+    for(std::shared_ptr<std::promise<Json::Value>>& promise : promises)
+    {
+        promise = std::make_shared<std::promise<Json::Value>>();
+        futures.push_back(promise->get_future());
+    }
+    
+    broadcast(_request, [promises](std::size_t _connection, const ObsMessage& _response, std::exception_ptr _error)
+    {
+        //connections added after the futures were handed out aren't reported
+        if(_connection >= promises.size()) return;
+        
+        if(_error) promises[_connection]->set_exception(_error);
+        else promises[_connection]->set_value(_response.json());
+    });
+    
+    return futures;
+}
+
+void ObsConnectionManager::broadcast(Json::Value& _request, BroadcastCallback _callback)
+{
+    broadcast(_request["request-type"].asString(), [&_request](std::string& _payload, uint64_t _messageId)
+    {
+        _request["message-id"] = std::to_string(_messageId);
+        
+        //no header and no mask, every connection frames and masks its own copy
+        JsonFrameWriter json(_payload, true);
+        json.fields(_request);
+        json.finish();
+    }, std::move(_callback));
+}
+
+std::vector<std::future<Json::Value>> ObsConnectionManager::broadcast(ConstantRequest _request)
+{
+    const ConstantRequestTemplate& request = constantRequestTemplates[static_cast<std::size_t>(_request)];
+    
+    std::vector<std::shared_ptr<std::promise<Json::Value>>> promises(connections().size());
+    std::vector<std::future<Json::Value>> futures;
+    for(std::shared_ptr<std::promise<Json::Value>>& promise : promises)
+    {
+        promise = std::make_shared<std::promise<Json::Value>>();
+        futures.push_back(promise->get_future());
+    }
+    
+    broadcast(request.requestType, [&request](std::string& _payload, uint64_t _messageId)
+    {
+        char digits[20];
+        _payload.assign(request.prefix, request.prefixSize);
+        _payload.append(digits, writeDecimal(digits, _messageId));
+        _payload.append("\"}", 2);
+    }, [promises](std::size_t _connection, const ObsMessage& _response, std::exception_ptr _error)
+    {
+        if(_connection >= promises.size()) return;
+        
+        if(_error) promises[_connection]->set_exception(_error);
+        else promises[_connection]->set_value(_response.json());
+    });
+    
+    return futures;
+}
+
+void ObsConnectionManager::broadcast(const std::string& _requestType, const std::function<void(std::string& _payload, uint64_t _messageId)>& _writePayload, BroadcastCallback _callback)
+{
+    const std::vector<ObsMessageHandler*> targets = connections();
+    
+    //one id for all of them means one payload for all of them. Every connection hands out its own ids in
+    //order, so this is the highest next id among them, pushed up again when one got there first
+    uint64_t messageId = 0;
+    for(ObsMessageHandler* handler : targets) messageId = std::max<uint64_t>(messageId, handler->nextMessageId);
+    
+    bool reserved = false;
+    while(!reserved)
+    {
+        reserved = true;
+        for(ObsMessageHandler* handler : targets)
+        {
+            if(handler->reserveMessageId(messageId)) continue;
+            messageId = handler->nextMessageId;
+            reserved = false;
+            break;
+        }
+    }
+    
+    std::string payload;
+    _writePayload(payload, messageId);
+    const std::shared_ptr<const std::string> shared = std::make_shared<const std::string>(std::move(payload));
+    
+    //a connection between reconnect attempts holds it like any other request, one that is closed or never
+    //connected fails it straight away
+    for(std::size_t i = 0; i < targets.size(); i++)
+    {
+        targets[i]->sendShared(shared, messageId, _requestType, [_callback, i](const ObsMessage& _response, std::exception_ptr _error)
+        {
+            _callback(i, _response, _error);
+        });
+    }
+}
+
+ManagerHealth ObsConnectionManager::health() const
+{
+    ManagerHealth total;
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    
+    for(const std::unique_ptr<ObsMessageHandler>& handler : handlers)
+    {
+        const ConnectionHealth health = handler->health();
+        total.connections++;
+        total.pendingRequests += health.pendingRequests;
+        if(!health.connected) continue;
+        
+        total.connected++;
+        total.longestSilence = std::max(total.longestSilence, health.silence);
+    }
+    
+    return total;
+}
+
+/* -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------  */
+
 int main()
 {
     
@@ -792,9 +4008,17 @@ int main()
     std::string port = "4444";
     messagehandler.connect(ip, port);
     std::string l = "Scene 2";
-    messagehandler.r_GetSceneList();
-
+    messagehandler.onEvent(ObsEventType::SwitchScenes, [](const ObsMessage& _event)
+    {
+        std::string sceneName;
+        if(_event.getString("scene-name", sceneName)) std::cout << "Switched to " << sceneName << std::endl;
+    });
     messagehandler.recieveUsingThread();
+    
+    std::future<Json::Value> version = messagehandler.r_GetVersion();
+    std::future<Json::Value> sceneList = messagehandler.r_GetSceneList();
+    std::cout << version.get() << sceneList.get() << std::endl;
+    
     std::cin.get();
     
     
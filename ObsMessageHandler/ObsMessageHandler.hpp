@@ -13,9 +13,26 @@
 #pragma GCC visibility push(default)
 
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <memory>
+#include <stdexcept>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <unordered_map>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
 #include <boost/beast/core.hpp>
 #include <boost/beast/websocket.hpp>
 #include <boost/asio/connect.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <json.h>
 #include <openssl/sha.h>
@@ -31,120 +48,932 @@ namespace net = boost::asio;
 using tcp = boost::asio::ip::tcp;
 
 
-enum requestMessageId
-{
-    GETVERSION = 0,
-    GETAUTHREQUIRED,
-    AUTHENTICATE,
-    SETHEARTBEAT,
-    SETFILENAMEFORMATTING,
-    GETFILENAMEFORMATTING,
-    GETSTATS,
-    BROADCASTCUSTOMMESSAGE,
-    GETVIDEOINFO,
-    OPENPROJECTOR,
-    LISTOUTPUTS,
-    GETOUTPUTINFO,
-    STARTOUTPUT,
-    STOPOUTPUT,
-    SETCURRENTPROFILE,
-    GETCURRENTPROFILE,
-    LISTPROFILES,
-    STARTSTOPRECORDING,
-    STARTRECORDING,
-    STOPRECORDING,
-    PAUSERECORDING,
-    RESUMERECORDING,
-    SETRECORDINGFOLDER,
-    GETRECORDINGFOLDER,
-    STARTSTOPREPLAYBUFFER,
-    STARTREPLAYBUFFER,
-    STOPREPLAYBUFFER,
-    SAVEREPLAYBUFFER,
-    SETCURRENTSCENECOLLECTION,
-    GETCURRENTSCENECOLLECTION,
-    LISTSCENECOLLECTIONS,
-    GETSCENEITEMPROPERTIES,
-    SETSCENEITEMPROPERTIES,
-    RESETSCENEITEM,
-    DELETESCENEITEM,
-    DUPLICATESCENEITEM,
-    SETCURRENTSCENE,
-    GETCURRENTSCENE,
-    GETSCENELIST
-    
-};
-
-struct Position;
-struct Scale;
-struct Crop;
-struct Bounds;
+class ObsMessage;
+
+//_error is set (and _response empty) when the request failed locally, e.g. ObsRequestTimeout
+typedef std::function<void(const ObsMessage& _response, std::exception_ptr _error)> ResponseCallback;
+
+class ObsRequestTimeout : public std::runtime_error
+{
+public:
+    explicit ObsRequestTimeout(const std::string& _requestType) : std::runtime_error(_requestType + " timed out") {}
+};
+
+//bookkeeping that isn't part of the interface, see ObsMessageHandlerPriv.hpp
+class PendingTable;
+class TimerWheel;
+class HandlerMemory;
+
+//requests without fields, sent from a prebuilt template with only the message-id digits filled in
+enum class ConstantRequest
+{
+    GetVersion,
+    GetAuthRequired,
+    GetFilenameFormatting,
+    GetStats,
+    GetVideoInfo,
+    ListOutputs,
+    GetCurrentProfile,
+    ListProfiles,
+    StartStopRecording,
+    StartRecording,
+    StopRecording,
+    PauseRecording,
+    ResumeRecording,
+    GetRecordingFolder,
+    StartStopReplayBuffer,
+    StartReplayBuffer,
+    StopReplayBuffer,
+    SaveReplayBuffer,
+    GetCurrentSceneCollection,
+    ListSceneCollections,
+    GetCurrentScene,
+    GetSceneList
+};
+
+//events see:https://github.com/Palakis/obs-websocket/blob/4.x-current/docs/generated/protocol.md#events
+#define OBS_EVENT_TYPES(X) \
+    X(SwitchScenes) \
+    X(ScenesChanged) \
+    X(SceneCollectionChanged) \
+    X(SceneCollectionListChanged) \
+    X(SwitchTransition) \
+    X(TransitionListChanged) \
+    X(TransitionDurationChanged) \
+    X(TransitionBegin) \
+    X(TransitionEnd) \
+    X(TransitionVideoEnd) \
+    X(ProfileChanged) \
+    X(ProfileListChanged) \
+    X(StreamStarting) \
+    X(StreamStarted) \
+    X(StreamStopping) \
+    X(StreamStopped) \
+    X(StreamStatus) \
+    X(RecordingStarting) \
+    X(RecordingStarted) \
+    X(RecordingStopping) \
+    X(RecordingStopped) \
+    X(RecordingPaused) \
+    X(RecordingResumed) \
+    X(VirtualCamStarted) \
+    X(VirtualCamStopped) \
+    X(ReplayStarting) \
+    X(ReplayStarted) \
+    X(ReplayStopping) \
+    X(ReplayStopped) \
+    X(Exiting) \
+    X(Heartbeat) \
+    X(BroadcastCustomMessage) \
+    X(SourceCreated) \
+    X(SourceDestroyed) \
+    X(SourceVolumeChanged) \
+    X(SourceMuteStateChanged) \
+    X(SourceAudioDeactivated) \
+    X(SourceAudioActivated) \
+    X(SourceAudioSyncOffsetChanged) \
+    X(SourceAudioMixersChanged) \
+    X(SourceRenamed) \
+    X(SourceFilterAdded) \
+    X(SourceFilterRemoved) \
+    X(SourceFilterVisibilityChanged) \
+    X(SourceFiltersReordered) \
+    X(MediaPlaying) \
+    X(MediaPaused) \
+    X(MediaRestarted) \
+    X(MediaStopped) \
+    X(MediaNext) \
+    X(MediaPrevious) \
+    X(MediaStarted) \
+    X(MediaEnded) \
+    X(SourceOrderChanged) \
+    X(SceneItemAdded) \
+    X(SceneItemRemoved) \
+    X(SceneItemVisibilityChanged) \
+    X(SceneItemLockChanged) \
+    X(SceneItemTransformChanged) \
+    X(SceneItemSelected) \
+    X(SceneItemDeselected) \
+    X(PreviewSceneChanged) \
+    X(StudioModeSwitched)
+
+enum class ObsEventType
+{
+#define OBS_EVENT_ENUM(name) name,
+    OBS_EVENT_TYPES(OBS_EVENT_ENUM)
+#undef OBS_EVENT_ENUM
+    Unknown
+};
+
+static const std::size_t obsEventTypeCount = static_cast<std::size_t>(ObsEventType::Unknown);
+
+//update-type strings are looked up through a switch on this hash, duplicate case labels would fail to compile
+constexpr uint64_t hashUpdateType(const char* _data, std::size_t _size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(std::size_t i = 0; i < _size; i++) hash = (hash ^ static_cast<unsigned char>(_data[i])) * 1099511628211ull;
+    return hash;
+}
+
+ObsEventType eventTypeFromString(const char* _data, std::size_t _size);
+const char* eventTypeName(ObsEventType _type);
+
+//an incoming frame. Construction only walks the top level of the object to find the routing keys,
+//values are read on demand and json() parses the whole frame the first time it is called.
+//It points into the read buffer, so it is only valid for the duration of the callback it is handed to
+class ObsMessage
+{
+public:
+    ObsMessage() = default;
+    ObsMessage(const char* _data, std::size_t _size, Json::CharReader* _reader);
+    
+    bool valid() const { return isValid; }
+    bool isResponse() const { return messageIdField.value != nullptr; }
+    bool isEvent() const { return updateTypeField.value != nullptr; }
+    
+    //0 when there is no numeric message-id
+    uint64_t messageId() const;
+    ObsEventType eventType() const;
+    std::string updateType() const;
+    
+    //top level fields only, false when the key is missing or holds a different type
+    bool has(const char* _key) const;
+    bool getString(const char* _key, std::string& _value) const;
+    bool getNumber(const char* _key, double& _value) const;
+    bool getInt(const char* _key, int64_t& _value) const;
+    bool getBool(const char* _key, bool& _value) const;
+    
+    const Json::Value& json() const;
+    const char* data() const { return frame; }
+    std::size_t size() const { return frameSize; }
+    
+private:
+    //raw slices of the frame, string values keep their quotes and escapes
+    struct Member
+    {
+        const char* key = nullptr;
+        std::size_t keySize = 0;
+        const char* value = nullptr;
+        std::size_t valueSize = 0;
+    };
+    
+    static const int maxMembers = 32;
+    
+    bool scan();
+    bool find(const char* _key, Member& _member) const;
+    
+    const char* frame = nullptr;
+    std::size_t frameSize = 0;
+    Json::CharReader* reader = nullptr;
+    bool isValid = false;
+    
+    //members past maxMembers aren't recorded, find() walks them again from overflow
+    Member members[maxMembers];
+    int memberCount = 0;
+    const char* overflow = nullptr;
+    Member messageIdField;
+    Member updateTypeField;
+    
+    mutable Json::Value document;
+    mutable bool parsed = false;
+};
+
+typedef std::function<void(const ObsMessage& _event)> EventCallback;
+
+struct EventHandler
+{
+    uint64_t id;
+    EventCallback callback;
+};
+
+//tcp socket that funnels every outgoing byte through one buffer, so the frames ObsMessageHandler
+//writes and Beast's own control frames (pong, close) can never interleave on the wire.
+//Apart from the synchronous handshake it is only used from the io thread.
+class FrameSocket
+{
+public:
+    typedef tcp::socket next_layer_type;
+    typedef tcp::socket::executor_type executor_type;
+    
+    explicit FrameSocket(const executor_type& _executor) : socket(_executor) {}
+    
+    executor_type get_executor() { return socket.get_executor(); }
+    tcp::socket& next_layer() { return socket; }
+    const tcp::socket& next_layer() const { return socket; }
+    
+    //bytes appended here go out with the next flush, anything added while a write is
+    //in flight is coalesced into the write after it
+    beast::flat_buffer& outgoing() { return pendingBytes; }
+    void flush();
+    
+    template<class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& _buffers) { return socket.read_some(_buffers); }
+    
+    template<class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& _buffers, beast::error_code& _ec) { return socket.read_some(_buffers, _ec); }
+    
+    template<class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& _buffers) { return socket.write_some(_buffers); }
+    
+    template<class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& _buffers, beast::error_code& _ec) { return socket.write_some(_buffers, _ec); }
+    
+    template<class MutableBufferSequence, class ReadHandler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(ReadHandler, void(beast::error_code, std::size_t))
+    async_read_some(const MutableBufferSequence& _buffers, ReadHandler&& _handler)
+    {
+        return socket.async_read_some(_buffers, std::forward<ReadHandler>(_handler));
+    }
+    
+    //Beast's writes are queued behind ours and reported complete straight away
+    template<class ConstBufferSequence, class WriteHandler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(WriteHandler, void(beast::error_code, std::size_t))
+    async_write_some(const ConstBufferSequence& _buffers, WriteHandler&& _handler)
+    {
+        return net::async_initiate<WriteHandler, void(beast::error_code, std::size_t)>([this](auto&& _handler, const ConstBufferSequence& _buffers)
+        {
+            const std::size_t size = net::buffer_size(_buffers);
+            pendingBytes.commit(net::buffer_copy(pendingBytes.prepare(size), _buffers));
+            flush();
+            
+            net::post(get_executor(), beast::bind_front_handler(std::forward<decltype(_handler)>(_handler), beast::error_code(), size));
+        }, _handler, _buffers);
+    }
+    
+private:
+    tcp::socket socket;
+    beast::flat_buffer pendingBytes;
+    beast::flat_buffer writingBytes;
+    bool flushing = false;
+};
+
+inline void teardown(beast::role_type _role, FrameSocket& _socket, beast::error_code& _ec)
+{
+    beast::websocket::teardown(_role, _socket.next_layer(), _ec);
+}
+
+template<class TeardownHandler>
+void async_teardown(beast::role_type _role, FrameSocket& _socket, TeardownHandler&& _handler)
+{
+    beast::websocket::async_teardown(_role, _socket.next_layer(), std::forward<TeardownHandler>(_handler));
+}
+
+enum class FlushMode
+{
+    Immediate,  //write as soon as the io thread gets to it, frames queued meanwhile share the next write
+    Window,     //hold the first queued frame for the flush window so a burst leaves in one write
+    Manual      //only write when flush() is called, e.g. once per frame tick
+};
+
+//-5 and "NULL" mean unset when these are passed to a request
+struct Position {
+    int x = -5;
+    int y = -5;
+    int alignment = -5;
+};
+
+struct Scale {
+    double x = -5;
+    double y = -5;
+};
+
+struct Crop {
+    int top = -5;
+    int bottom = -5;
+    int left = -5;
+    int right = -5;
+};
+
+struct Bounds {
+    std::string type = "NULL";
+    int alignment = -5;
+    int x = -5;
+    int y = -5;
+};
+
+//what OBS reports and what the transform cache holds, OBS keeps positions and bounds fractional
+struct ItemPosition {
+    double x = -5;
+    double y = -5;
+    int alignment = -5;
+};
+
+struct ItemBounds {
+    std::string type = "NULL";
+    int alignment = -5;
+    double x = -5;
+    double y = -5;
+};
+
+//backing storage for a decoded response. Blocks are chained and released together, the first one
+//is sized from the frame so a whole response normally fits in a single allocation
+class ResponseArena
+{
+public:
+    explicit ResponseArena(std::size_t _capacity = 0) : nextCapacity(_capacity) {}
+    ResponseArena(ResponseArena&& _other) noexcept;
+    ResponseArena& operator=(ResponseArena&& _other) noexcept;
+    ~ResponseArena();
+    
+    void* allocate(std::size_t _size, std::size_t _alignment);
+    
+    template<class T>
+    T* construct(std::size_t _count)
+    {
+        //nothing in an arena gets destroyed
+        static_assert(std::is_trivially_destructible<T>::value, "arena types must be trivially destructible");
+        T* items = static_cast<T*>(allocate(sizeof(T) * _count, alignof(T)));
+        for(std::size_t i = 0; i < _count; i++) new(items + i) T();
+        return items;
+    }
+    
+private:
+    struct Block
+    {
+        Block* next;
+    };
+    
+    void release();
+    
+    Block* blocks = nullptr;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    std::size_t nextCapacity;
+};
+
+struct ArenaString
+{
+    const char* data = nullptr;
+    std::size_t size = 0;
+    
+    std::string str() const { return std::string(data, size); }
+    bool operator==(const char* _other) const { return std::strlen(_other) == size && std::memcmp(data, _other, size) == 0; }
+    bool operator!=(const char* _other) const { return !(*this == _other); }
+};
+
+template<class T>
+struct ArenaArray
+{
+    T* items = nullptr;
+    std::size_t count = 0;
+    
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](std::size_t _index) const { return items[_index]; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+};
+
+//typed responses, see the protocol docs for the meaning of the fields. Fields missing from the response keep their defaults
+struct SceneItem
+{
+    ArenaString name;
+    int64_t id = 0;
+    ArenaString type;
+    double x = 0;
+    double y = 0;
+    double cx = 0;
+    double cy = 0;
+    double volume = 0;
+    int sourceCx = 0;
+    int sourceCy = 0;
+    int alignment = 0;
+    bool render = false;
+    bool muted = false;
+    bool locked = false;
+    ArenaString parentGroupName;
+    ArenaArray<SceneItem> groupChildren;
+};
+
+struct Scene
+{
+    ArenaString name;
+    ArenaArray<SceneItem> sources;
+};
+
+struct SceneList
+{
+    ArenaString currentScene;
+    ArenaArray<Scene> scenes;
+};
+
+struct SceneItemProperties
+{
+    ArenaString name;
+    int64_t itemId = 0;
+    ItemPosition position;
+    double rotation = 0;
+    Scale scale;
+    Crop crop;
+    bool visible = false;
+    bool muted = false;
+    bool locked = false;
+    ItemBounds bounds;
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+    double width = 0;
+    double height = 0;
+    ArenaString parentGroupName;
+};
+
+struct OutputFlags
+{
+    int rawValue = 0;
+    bool audio = false;
+    bool video = false;
+    bool encoded = false;
+    bool multiTrack = false;
+    bool service = false;
+};
+
+struct Output
+{
+    ArenaString name;
+    ArenaString type;
+    int width = 0;
+    int height = 0;
+    OutputFlags flags;
+    bool active = false;
+    bool reconnecting = false;
+    double congestion = 0;
+    int64_t totalFrames = 0;
+    int64_t droppedFrames = 0;
+    int64_t totalBytes = 0;
+};
+
+struct OutputList
+{
+    ArenaArray<Output> outputs;
+};
+
+struct ObsStats
+{
+    double fps = 0;
+    int64_t renderTotalFrames = 0;
+    int64_t renderMissedFrames = 0;
+    int64_t outputTotalFrames = 0;
+    int64_t outputSkippedFrames = 0;
+    double averageFrameTime = 0;
+    double cpuUsage = 0;
+    double memoryUsage = 0;
+    double freeDiskSpace = 0;
+};
+
+struct VideoInfo
+{
+    int baseWidth = 0;
+    int baseHeight = 0;
+    int outputWidth = 0;
+    int outputHeight = 0;
+    ArenaString scaleType;
+    double fps = 0;
+    ArenaString videoFormat;
+    ArenaString colorSpace;
+    ArenaString colorRange;
+};
+
+//a response and the arena its strings and arrays live in, moving it keeps them valid
+template<class T>
+struct Decoded
+{
+    ResponseArena arena;
+    T value;
+    
+    const T& operator*() const { return value; }
+    const T* operator->() const { return &value; }
+};
+
+//scene state mirrored by the handler, see enableSceneCache(). Snapshots are immutable and
+//scenes that didn't change are shared between them
+struct CachedSceneItem
+{
+    std::string name;
+    int64_t id = 0;
+    std::string type;
+    double x = 0;
+    double y = 0;
+    double cx = 0;
+    double cy = 0;
+    int alignment = 0;
+    bool render = false;
+    bool locked = false;
+};
+
+struct CachedScene
+{
+    std::string name;
+    std::vector<CachedSceneItem> items;
+};
+
+struct SceneState
+{
+    std::string currentScene;
+    std::vector<std::shared_ptr<const CachedScene>> scenes;
+    
+    //bumped for every change. Stale means the mirror can't be trusted until the next resync lands,
+    //e.g. the connection dropped or an event referred to something the mirror didn't know about
+    uint64_t version = 0;
+    bool stale = true;
+    std::chrono::steady_clock::time_point syncedAt;
+    
+    const CachedScene* findScene(const std::string& _name) const;
+};
+
+//last known transform of a scene item, sentinels mean OBS's value isn't known
+struct ItemTransform
+{
+    ItemPosition position;
+    double rotation = -5;
+    Scale scale;
+    Crop crop;
+    int visible = -1;
+    int locked = -1;
+    ItemBounds bounds;
+};
+
+enum class Easing
+{
+    Linear,
+    EaseInQuad,
+    EaseOutQuad,
+    EaseInOutQuad,
+    EaseInCubic,
+    EaseOutCubic,
+    EaseInOutCubic,
+    EaseInOutSine
+};
+
+//a running animate() call, position, rotation, scale and crop fields that are set in to are interpolated
+struct Tween
+{
+    uint64_t id;
+    std::string sceneName;
+    std::string item;
+    ItemTransform from;
+    ItemTransform to;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration duration;
+    Easing easing;
+    std::function<void()> done;
+    bool finished;
+};
+
+//a setter held back by the coalescing stage. Later calls for the same key overwrite its fields until it
+//is written, so each field goes out with its newest value and every caller gets that request's response
+struct CoalescedRequest
+{
+    const char* requestType = nullptr;
+    std::string sceneName;
+    std::string item;
+    std::string itemName = "NULL";
+    int itemId = -5;
+    ItemTransform transform;
+    std::vector<ResponseCallback> waiters;
+    std::chrono::steady_clock::duration minInterval{0};
+    bool ownRateCap = false;
+    std::chrono::steady_clock::time_point lastSent;
+    bool held = false;
+};
+
+struct ConnectionHealth
+{
+    bool connected = false;
+    std::size_t pendingRequests = 0;
+    //since the last frame from OBS, duration::max() when none came yet
+    std::chrono::steady_clock::duration silence = std::chrono::steady_clock::duration::max();
+};
+
+struct ManagerHealth
+{
+    std::size_t connections = 0;
+    std::size_t connected = 0;
+    std::size_t pendingRequests = 0;
+    //the quietest of the connected ones
+    std::chrono::steady_clock::duration longestSilence{0};
+};
+
+class ObsResponseError : public std::runtime_error
+{
+public:
+    explicit ObsResponseError(const std::string& _message) : std::runtime_error(_message) {}
+};
+
+//false with _error set when the response has status "error" or doesn't have the expected shape
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, SceneList& _out, std::string& _error);
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, SceneItemProperties& _out, std::string& _error);
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, OutputList& _out, std::string& _error);
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, ObsStats& _out, std::string& _error);
+bool decodeResponse(const ObsMessage& _message, ResponseArena& _arena, VideoInfo& _out, std::string& _error);
 
 class ObsMessageHandler
 {
 public:
     
+    //owns its io_context and runs it on a thread of its own once connected
     ObsMessageHandler();
+    //runs on _ioc, which the caller keeps running on as many threads as it likes; this connection's handlers
+    //are serialized on a strand of it. Close it and let its handlers finish before destroying it
+    explicit ObsMessageHandler(net::io_context& _ioc);
     ~ObsMessageHandler();
     
+    //once close() ran, or the connection failed or dropped without reconnecting, requests fail straight away with "Not connected."
     bool connect(std::string& _ip, std::string& _port);
+    //sends a close frame, OBS gets a second to answer before the socket is shut. Returns straight away
+    void close();
+    ConnectionHealth health() const;
+    
+    //opt-in: a dropped connection is reopened with jittered exponential backoff between _initialDelay and _maxDelay.
+    //Requests made while it is down are held and go out once the session is back: authenticated again when a
+    //password is set, SetHeartbeat replayed and the scene cache resynced. Requests already written to the lost
+    //connection end in ObsRequestTimeout. recieve() then only returns after close()
+    void enableReconnect(bool _enable = true, std::chrono::milliseconds _initialDelay = std::chrono::milliseconds(50), std::chrono::milliseconds _maxDelay = std::chrono::milliseconds(800));
+    //every session asks GetAuthRequired and authenticates when OBS wants it, before anything queued goes out
+    void setPassword(const std::string& _password);
+    
+    //stamps a unique message-id on _request and completes once the matching response arrives,
+    //or fails with ObsRequestTimeout after _timeout (zero means the default request timeout)
+    std::future<Json::Value> sendRequest(Json::Value& _request, std::chrono::milliseconds _timeout = std::chrono::milliseconds::zero());
+    void sendRequest(Json::Value& _request, ResponseCallback _callback, std::chrono::milliseconds _timeout = std::chrono::milliseconds::zero());
+    std::future<Json::Value> sendRequest(ConstantRequest _request, std::chrono::milliseconds _timeout = std::chrono::milliseconds::zero());
+    void sendRequest(ConstantRequest _request, ResponseCallback _callback, std::chrono::milliseconds _timeout = std::chrono::milliseconds::zero());
+    void setRequestTimeout(std::chrono::milliseconds _timeout);
+    
+    //handlers run on the receiving thread, the returned id can be passed to removeEventHandler
+    uint64_t onEvent(ObsEventType _type, EventCallback _callback);
+    uint64_t onEvent(const std::string& _updateType, EventCallback _callback);
+    void removeEventHandler(uint64_t _handlerId);
+    
+    void setFlushMode(FlushMode _mode, std::chrono::microseconds _window = std::chrono::microseconds(200));
+    void flush();
     
     //requests see:https://github.com/Palakis/obs-websocket/blob/4.x-current/docs/generated/protocol.md
     
-    void r_GetVersion();
-    void r_GetAuthRequired();
-    void r_Authenticate(std::string& _challenge, std::string& _salt, std::string& _password);
-    void r_SetHeartbeat(bool _enable);
-    void r_SetFilenameFormatting(std::string& _format);
-    void r_GetFilenameFormatting();
-    void r_GetStats();
-    void r_BroadcastCustomMessage(std::string _realm, Json::Value& _object);
-    void r_GetVideoInfo();
-    void r_OpenProjector(std::string _type, int _monitor, int _x, int _y, int _width, int _height, std::string _name);
-    void r_ListOutputs();
-    void r_GetOutputInfo(std::string& _outputName);
-    void r_StartOutput(std::string& _outputName);
-    void r_StopOutput(std::string& _outputName, bool _force);
-    void r_SetCurrentProfile(std::string& _profileName);
-    void r_GetCurrentProfile();
-    void r_ListProfiles();
-    void r_StartStopRecording();
-    void r_StartRecording();
-    void r_StopRecording();
-    void r_PauseRecording();
-    void r_ResumeRecording();
-    void r_SetRecordingFolder(std::string& _recFolder);
-    void r_GetRecordingFolder();
-    void r_StartStopReplayBufer();
-    void r_StartReplayBuffer();
-    void r_StopReplayBuffer();
-    void r_SaveReplayBuffer();
-    void r_SetCurrentSceneCollection(std::string& _scName);
-    void r_GetCurrentSceneCollection();
-    void r_ListSceneCollections();
-    void r_GetSceneItemProperties(std::string _item, std::string _sceneName, std::string _itemName, int _itemId);
-    void r_SetSceneItemProperties(std::string _item, std::string _sceneName, std::string _itemName, int _itemId, Position _position, double _rotation, Scale _scale, Crop _crop, int _visible, int _locked, Bounds _bounds);
-    void r_ResetSceneItem(std::string _item, std::string _sceneName, std::string _itemName, int _itemId);
-    void r_DeleteSceneItem(std::string _item, std::string _sceneName, std::string _itemName, int _itemId);
+    std::future<Json::Value> r_GetVersion();
+    std::future<Json::Value> r_GetAuthRequired();
+    std::future<Json::Value> r_Authenticate(std::string& _challenge, std::string& _salt, std::string& _password);
+    std::future<Json::Value> r_SetHeartbeat(bool _enable);
+    std::future<Json::Value> r_SetFilenameFormatting(std::string& _format);
+    std::future<Json::Value> r_GetFilenameFormatting();
+    std::future<Json::Value> r_GetStats();
+    std::future<Json::Value> r_BroadcastCustomMessage(std::string _realm, Json::Value& _object);
+    std::future<Json::Value> r_GetVideoInfo();
+    std::future<Json::Value> r_OpenProjector(std::string _type, int _monitor, int _x, int _y, int _width, int _height, std::string _name);
+    std::future<Json::Value> r_ListOutputs();
+    std::future<Json::Value> r_GetOutputInfo(std::string& _outputName);
+    std::future<Json::Value> r_StartOutput(std::string& _outputName);
+    std::future<Json::Value> r_StopOutput(std::string& _outputName, bool _force);
+    std::future<Json::Value> r_SetCurrentProfile(std::string& _profileName);
+    std::future<Json::Value> r_GetCurrentProfile();
+    std::future<Json::Value> r_ListProfiles();
+    std::future<Json::Value> r_StartStopRecording();
+    std::future<Json::Value> r_StartRecording();
+    std::future<Json::Value> r_StopRecording();
+    std::future<Json::Value> r_PauseRecording();
+    std::future<Json::Value> r_ResumeRecording();
+    std::future<Json::Value> r_SetRecordingFolder(std::string& _recFolder);
+    std::future<Json::Value> r_GetRecordingFolder();
+    std::future<Json::Value> r_StartStopReplayBufer();
+    std::future<Json::Value> r_StartReplayBuffer();
+    std::future<Json::Value> r_StopReplayBuffer();
+    std::future<Json::Value> r_SaveReplayBuffer();
+    std::future<Json::Value> r_SetCurrentSceneCollection(std::string& _scName);
+    std::future<Json::Value> r_GetCurrentSceneCollection();
+    std::future<Json::Value> r_ListSceneCollections();
+    std::future<Json::Value> r_GetSceneItemProperties(std::string _item, std::string _sceneName, std::string _itemName, int _itemId);
+    std::future<Json::Value> r_SetSceneItemProperties(std::string _item, std::string _sceneName, std::string _itemName, int _itemId, Position _position, double _rotation, Scale _scale, Crop _crop, int _visible, int _locked, Bounds _bounds);
+    std::future<Json::Value> r_ResetSceneItem(std::string _item, std::string _sceneName, std::string _itemName, int _itemId);
+    std::future<Json::Value> r_DeleteSceneItem(std::string _item, std::string _sceneName, std::string _itemName, int _itemId);
     void r_DuplicateSceneItem(/* moet nog doen*/);
-    void r_SetCurrentScene(std::string& _sceneName);
-    void r_GetCurrentScene();
-    void r_GetSceneList();
+    std::future<Json::Value> r_SetCurrentScene(std::string& _sceneName);
+    std::future<Json::Value> r_GetCurrentScene();
+    std::future<Json::Value> r_GetSceneList();
+    
+    //the same requests with their responses decoded into the structs above
+    std::future<Decoded<SceneList>> getSceneList();
+    std::future<Decoded<SceneItemProperties>> getSceneItemProperties(std::string _item, std::string _sceneName, std::string _itemName, int _itemId);
+    std::future<Decoded<OutputList>> listOutputs();
+    std::future<Decoded<ObsStats>> getStats();
+    std::future<Decoded<VideoInfo>> getVideoInfo();
     
+    //opt-in mirror of the scene list and current scene, seeded by one GetSceneList and kept current from events.
+    //sceneState() never blocks and never goes to the network; resyncSceneState() reseeds it
+    void enableSceneCache(bool _enable = true);
+    std::shared_ptr<const SceneState> sceneState() const;
+    void resyncSceneState();
+    
+    //opt-in cache of item transforms, kept current from SceneItem* events. While it is on,
+    //r_SetSceneItemProperties only sends the fields that differ from it and skips the request when none do.
+    //Items addressed without a scene name aren't cached
+    void enableTransformCache(bool _enable = true);
+    
+    //tweens are stepped together on the io thread and every tick leaves as one socket write.
+    //Unset fields in _from start at the cached transform, or jump straight to _to when that isn't known.
+    //A new animation of an item replaces the one already running on it; _done runs on the io thread
+    uint64_t animate(const std::string& _sceneName, const std::string& _item, ItemTransform _from, const ItemTransform& _to, std::chrono::milliseconds _duration, Easing _easing = Easing::Linear, std::function<void()> _done = nullptr);
+    void cancelAnimation(uint64_t _animationId);
+    //ticks per second, 0 follows the fps reported by GetVideoInfo
+    void setAnimationRate(double _fps);
+    
+    //opt-in last-write-wins stage for r_SetSceneItemProperties and r_SetCurrentScene, keyed by (request-type, scene, item).
+    //A call is held until the queue is flushed and at least the key's rate cap after the last one sent for it;
+    //calls for a held key merge into it. Order is only kept between calls for the same key.
+    //_minInterval is the rate cap of every key without one of its own
+    void enableCoalescing(bool _enable = true, std::chrono::microseconds _minInterval = std::chrono::microseconds(0));
+    //r_SetCurrentScene uses an empty scene and item
+    void setRateCap(const std::string& _requestType, const std::string& _sceneName, const std::string& _item, std::chrono::microseconds _minInterval);
+    
+    //recieve() blocks until the connection closes, recieveUsingThread() returns straight away;
+    //either way frames are handled on the io thread
     void recieve();
     void recieveUsingThread();
     
 private:
-    friend void recieve();
-    net::io_context ioc;
-    tcp::resolver resolver{ioc};
-    websocket::stream<tcp::socket> ws{ioc};
+    friend struct FlushHandler;
+    friend class ObsConnectionManager;
     
+    void doRead();
+    void shutDown();
+    void scheduleReconnect();
+    void reconnect();
+    void resumeSession();
+    void openSession(uint64_t _session);
+    template<class WriteFields> void sendSessionRequest(const char* _requestType, ResponseCallback _callback, const WriteFields& _writeFields);
+    void refuseRequests();
+    bool refusingRequests() const;
+    uint64_t registerRequest(const char* _requestType, std::size_t _size, ResponseCallback& _callback, std::chrono::milliseconds _timeout);
+    bool registerRequest(uint64_t _messageId, const char* _requestType, std::size_t _size, ResponseCallback& _callback, std::chrono::milliseconds _timeout);
+    bool reserveMessageId(uint64_t _messageId);
+    void sendShared(const std::shared_ptr<const std::string>& _payload, uint64_t _messageId, const std::string& _requestType, ResponseCallback _callback);
+    template<class WriteFields> std::future<Json::Value> sendFields(const char* _requestType, const WriteFields& _writeFields);
+    template<class WriteFields> void sendFields(const char* _requestType, ResponseCallback _callback, std::chrono::milliseconds _timeout, const WriteFields& _writeFields);
+    void queueFrame(const char* _payload, std::size_t _size);
+    void scheduleFlush();
+    void postFlush(bool _windowed);
+    void flushQueue();
+    void handleMessage(const char* _data, std::size_t _size);
+    bool completeRequest(const ObsMessage& _response);
+    void dispatchEvent(const ObsMessage& _event);
+    void onWheelTick();
+    void applySceneEvent(ObsEventType _type, const ObsMessage& _event);
+    void invalidateSceneState(bool _resync);
+    void publishSceneState(std::shared_ptr<SceneState> _state);
+    bool applyTransformDelta(const std::string& _sceneName, const std::string& _item, ItemPosition& _position, double& _rotation, Scale& _scale, Crop& _crop, int& _visible, int& _locked, ItemBounds& _bounds);
+    void applyTransformEvent(ObsEventType _type, const ObsMessage& _event);
+    void forgetTransform(const std::string& _sceneName, const std::string& _item);
+    CoalescedRequest& coalescedRequest(const char* _requestType, const std::string& _sceneName, const std::string& _item);
+    bool holdCoalesced(CoalescedRequest& _request, ResponseCallback& _callback);
+    void releaseCoalesced();
+    void armCoalesceTimer(std::chrono::steady_clock::time_point _due);
+    void startAnimating();
+    void onAnimationTick();
+    void writeTweenFrame(Tween& _tween, std::chrono::steady_clock::time_point _now);
+    std::string authSecret(const std::string& _password, const std::string& _salt);
+    std::string authResponse(const std::string& _password, const std::string& _salt, const std::string& _challenge);
+    
+    //"the io thread" below means this strand when the io_context is shared
+    std::unique_ptr<net::io_context> ownedContext;
+    net::io_context& ioc;
+    net::strand<net::io_context::executor_type> strand;
+    tcp::resolver resolver{strand};
+    //replaced for every reconnect, the previous one is kept a round longer for the handlers its close aborted
+    std::unique_ptr<websocket::stream<FrameSocket>> ws{new websocket::stream<FrameSocket>(strand)};
+    std::unique_ptr<websocket::stream<FrameSocket>> retiredWs;
+    net::executor_work_guard<net::io_context::executor_type> ioWork{ioc.get_executor()};
+    net::steady_timer closeTimer{strand};
+    //set by shutDown so timers that fired before they were cancelled don't arm themselves again
+    bool stopped = false;
+    bool closing = false;
+    
+    //host, port and endpoints are kept for reconnecting and only touched on the io thread once connected
+    std::string host;
+    std::string port;
+    tcp::resolver::results_type endpoints;
+    std::atomic<bool> reconnectEnabled{false};
+    std::chrono::milliseconds reconnectDelay{50};
+    std::chrono::milliseconds reconnectMaxDelay{800};
+    unsigned reconnectAttempt = 0;
+    net::steady_timer reconnectTimer{strand};
+    std::minstd_rand reconnectJitter{std::random_device()()};
+    std::string password;
+    //salt and secret pairs for password, oldest first
+    static const std::size_t maxAuthSecrets = 4;
+    std::vector<std::pair<std::string, std::string>> authSecrets;
+    std::atomic<int> heartbeat{-1};
+    //bumped for every connection, callbacks from the session setup of an older one are ignored
+    uint64_t session = 0;
+    std::atomic<bool> connected{false};
+    std::atomic<std::chrono::steady_clock::rep> lastMessageAt{0};
+    
+    std::thread ioThread;
+    beast::flat_buffer readBuffer;
+    std::unique_ptr<Json::CharReader> jsonReader;
+    bool reading = false;
+    
+    //masked frames queued by the callers, moved over to the socket by the io thread
+    std::mutex sendMutex;
+    std::string queuedFrames;
+    bool writing = false;
+    //the queue is held while the connection is down or its session is still being set up
+    bool sessionOpen = false;
+    std::unique_ptr<HandlerMemory> flushHandlerMemory;
+    FlushMode flushMode = FlushMode::Immediate;
+    std::chrono::microseconds flushWindow{200};
+    net::steady_timer flushTimer{strand};
+    std::mt19937 maskGenerator{std::random_device()()};
+    
+    std::mutex stateMutex;
+    std::condition_variable closedCondition;
+    bool closed = false;
+    
+    std::atomic<uint64_t> nextMessageId{1};
+    mutable std::mutex pendingMutex;
+    std::unique_ptr<PendingTable> pendingRequests;
+    
+    std::chrono::milliseconds requestTimeout{5000};
+    std::unique_ptr<TimerWheel> timeoutWheel;
+    net::steady_timer wheelTimer{strand};
+    bool wheelTicking = false;
+    //set once the handler is stopped or its connection is gone for good, nothing would send or time out a request
+    bool requestsRefused = false;
+    std::vector<uint64_t> expiredIds;
+    
+    //copy-on-write so dispatch only holds eventMutex long enough to grab the list
+    typedef std::shared_ptr<const std::vector<EventHandler>> EventHandlerList;
+    std::mutex eventMutex;
+    std::array<EventHandlerList, obsEventTypeCount> eventHandlers;
+    std::unordered_map<std::string, EventHandlerList> customEventHandlers;
+    uint64_t nextEventHandlerId = 1;
+    
+    //written on the io thread only, read from anywhere through atomic_load
+    std::shared_ptr<const SceneState> sceneStateSnapshot = std::make_shared<SceneState>();
+    std::atomic<bool> sceneCacheEnabled{false};
+    std::atomic<bool> sceneResyncPending{false};
+    std::vector<uint64_t> sceneCacheHandlers;
+    
+    //keyed by scene name + '\0' + item name. transformKey is only a reusable lookup buffer
+    std::mutex transformMutex;
+    std::unordered_map<std::string, ItemTransform> itemTransforms;
+    std::string transformKey;
+    std::atomic<bool> transformCacheEnabled{false};
+    std::vector<uint64_t> transformCacheHandlers;
+    
+    //guarded by sendMutex, the held ones are written by flushQueue; the timer belongs to the io thread
+    std::atomic<bool> coalescingEnabled{false};
+    std::chrono::microseconds coalesceInterval{0};
+    std::unordered_map<std::string, CoalescedRequest> coalescedRequests;
+    std::vector<CoalescedRequest*> heldRequests;
+    std::string coalesceKey;
+    net::steady_timer coalesceTimer{strand};
+    std::chrono::steady_clock::time_point coalesceDeadline;
+    bool coalesceTimerArmed = false;
+    
+    //added and cancelled are handed over under animationMutex, tweens and the timer belong to the io thread
+    std::mutex animationMutex;
+    std::vector<Tween> addedTweens;
+    std::vector<uint64_t> cancelledTweens;
+    uint64_t nextTweenId = 1;
+    std::vector<Tween> tweens;
+    std::vector<std::function<void()>> finishedTweens;
+    net::steady_timer animationTimer{strand};
+    std::chrono::steady_clock::duration animationPeriod = std::chrono::microseconds(33333);
+    std::chrono::steady_clock::time_point nextAnimationTick;
+    bool animating = false;
 
+};
+
+//hosts many connections on one io_context run by a fixed pool of threads, each connection on its own strand.
+//Connections live as long as the manager; destroying it closes them all and waits for the pool to drain
+typedef std::function<void(std::size_t _connection, const ObsMessage& _response, std::exception_ptr _error)> BroadcastCallback;
+
+class ObsConnectionManager
+{
+public:
+    explicit ObsConnectionManager(std::size_t _threads = 2);
+    ~ObsConnectionManager();
+    
+    //connects and starts reading before returning. A connection that failed is kept and shows up in health()
+    ObsMessageHandler& add(std::string _host, std::string _port);
+    std::vector<ObsMessageHandler*> connections() const;
+    ManagerHealth health() const;
+    
+    //sends one request to every connection: it is serialized once under a message-id that is free on all of them and
+    //each connection masks its own copy on its strand. Results are indexed like connections(). A connection that
+    //is reconnecting holds it until its session is back, one that is closed or never connected fails straight away
+    std::vector<std::future<Json::Value>> broadcast(Json::Value& _request);
+    void broadcast(Json::Value& _request, BroadcastCallback _callback);
+    std::vector<std::future<Json::Value>> broadcast(ConstantRequest _request);
+    
+private:
+    void broadcast(const std::string& _requestType, const std::function<void(std::string& _payload, uint64_t _messageId)>& _writePayload, BroadcastCallback _callback);
     
-    std::thread recieveThread;
-    std::mutex recieveMutex;
 
+    net::io_context ioc;
+    net::executor_work_guard<net::io_context::executor_type> work{ioc.get_executor()};
+    std::vector<std::thread> threads;
+    
+    //after ioc, so the connections are gone before their io_context is
+    mutable std::mutex connectionMutex;
+    std::vector<std::unique_ptr<ObsMessageHandler>> handlers;
 };
 
 #pragma GCC visibility pop
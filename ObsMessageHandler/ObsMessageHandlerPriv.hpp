@@ -6,6 +6,10 @@
 //  Copyright © 2020 sipke woudstra. All rights reserved.
 //
 
+#include <string>
+#include <json.h>
+#include "ObsMessageHandler.hpp"
+
 /* The classes below are not exported */
 #pragma GCC visibility push(hidden)
 
@@ -14,4 +18,207 @@ class ObsMessageHandlerPriv
     public:
 };
 
+//the requests of ConstantRequest, in the same order; ObsMessageHandler.cpp builds their templates from this
+//list and checks the order at compile time
+#define OBS_CONSTANT_REQUESTS(X) \
+    X(GetVersion) \
+    X(GetAuthRequired) \
+    X(GetFilenameFormatting) \
+    X(GetStats) \
+    X(GetVideoInfo) \
+    X(ListOutputs) \
+    X(GetCurrentProfile) \
+    X(ListProfiles) \
+    X(StartStopRecording) \
+    X(StartRecording) \
+    X(StopRecording) \
+    X(PauseRecording) \
+    X(ResumeRecording) \
+    X(GetRecordingFolder) \
+    X(StartStopReplayBuffer) \
+    X(StartReplayBuffer) \
+    X(StopReplayBuffer) \
+    X(SaveReplayBuffer) \
+    X(GetCurrentSceneCollection) \
+    X(ListSceneCollections) \
+    X(GetCurrentScene) \
+    X(GetSceneList)
+
+//arena for the flush handler that callers post to the io thread; only one is ever in flight, so posting
+//it doesn't allocate. Going through the strand takes two blocks, the queued handler and the invoker that
+//runs the strand. See asio's custom allocation example.
+class HandlerMemory
+{
+public:
+    void* allocate(std::size_t _size)
+    {
+        if(_size <= blockSize)
+        {
+            for(int i = 0; i < blocks; i++)
+            {
+                bool expected = false;
+                if(inUse[i].compare_exchange_strong(expected, true)) return storage[i];
+            }
+        }
+        return ::operator new(_size);
+    }
+    
+    void deallocate(void* _pointer)
+    {
+        for(int i = 0; i < blocks; i++)
+        {
+            if(_pointer != storage[i]) continue;
+            inUse[i] = false;
+            return;
+        }
+        ::operator delete(_pointer);
+    }
+    
+private:
+    static const int blocks = 2;
+    static const std::size_t blockSize = 256;
+    
+    alignas(std::max_align_t) unsigned char storage[blocks][blockSize];
+    std::atomic<bool> inUse[blocks] = {};
+};
+
+template<class T>
+class HandlerAllocator
+{
+public:
+    typedef T value_type;
+    
+    explicit HandlerAllocator(HandlerMemory& _memory) : memory(&_memory) {}
+    template<class U> HandlerAllocator(const HandlerAllocator<U>& _other) noexcept : memory(_other.memory) {}
+    
+    T* allocate(std::size_t _count) { return static_cast<T*>(memory->allocate(sizeof(T) * _count)); }
+    void deallocate(T* _pointer, std::size_t) { memory->deallocate(_pointer); }
+    
+    template<class U> bool operator==(const HandlerAllocator<U>& _other) const noexcept { return memory == _other.memory; }
+    template<class U> bool operator!=(const HandlerAllocator<U>& _other) const noexcept { return memory != _other.memory; }
+    
+private:
+    template<class> friend class HandlerAllocator;
+    HandlerMemory* memory;
+};
+
+struct PendingRequest
+{
+    std::string requestType;
+    ResponseCallback callback;
+};
+
+//pending requests by message-id. Ids are handed out in order so slot id & mask is almost always free.
+//The table doubles when it is more than half full and halves again once it has been mostly empty for a
+//while; a lone old request still waiting in the slot a new id maps to is moved aside to stragglers instead,
+//so one slow request doesn't size the table. Slots are reused as they are, so a steady stream of requests
+//doesn't allocate.
+class PendingTable
+{
+public:
+    PendingTable() : slots(minSlots) {}
+    
+    PendingRequest& insert(uint64_t _id);
+    bool take(uint64_t _id, ResponseCallback& _callback, std::string* _requestType = nullptr);
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return slots.size(); }
+    
+private:
+    static const std::size_t minSlots = 64;
+    
+    struct Slot
+    {
+        uint64_t id = 0;
+        PendingRequest request;
+    };
+    
+    void resize(std::size_t _slots);
+    void setAside(Slot& _slot);
+    
+    std::vector<Slot> slots;
+    std::unordered_map<uint64_t, PendingRequest> stragglers;
+    //live requests, stragglers included
+    std::size_t count = 0;
+    //takes left before the table may halve again
+    std::size_t shrinkCountdown = minSlots;
+};
+
+//hierarchical timing wheel, 4 levels of 64 slots. Scheduling is O(1) and cancelling is lazy:
+//expired ids are handed back and the owner ignores the ones that already completed
+class TimerWheel
+{
+public:
+    typedef std::chrono::steady_clock clock;
+    
+    explicit TimerWheel(std::chrono::milliseconds _resolution);
+    
+    void schedule(uint64_t _id, clock::time_point _deadline);
+    void advance(clock::time_point _now, std::vector<uint64_t>& _expired);
+    
+    bool empty() const { return count == 0; }
+    clock::time_point nextTick() const { return origin + resolution * (currentTick + 1); }
+    
+private:
+    static const int levels = 4;
+    static const int slotBits = 6;
+    static const uint64_t slotMask = (1 << slotBits) - 1;
+    
+    struct Entry
+    {
+        uint64_t id;
+        uint64_t expiryTick;
+    };
+    
+    void place(const Entry& _entry);
+    
+    std::array<std::array<std::vector<Entry>, 1 << slotBits>, levels> slots;
+    std::vector<Entry> cascading;
+    clock::time_point origin;
+    std::chrono::milliseconds resolution;
+    uint64_t currentTick = 0;
+    std::size_t count = 0;
+};
+
+//serializes one request object straight into the queued frames: the header is reserved up front and
+//the payload is masked and slid into place by finish() once its size is known. With _payloadOnly nothing
+//is reserved and finish() leaves the payload unmasked, for one copy that each connection frames itself
+class JsonFrameWriter
+{
+public:
+    explicit JsonFrameWriter(std::string& _frames, bool _payloadOnly = false);
+    ~JsonFrameWriter();
+    
+    void field(const char* _key, const char* _value);
+    void field(const char* _key, const char* _value, std::size_t _size);
+    void field(const char* _key, const std::string& _value);
+    void field(const char* _key, int _value);
+    void field(const char* _key, double _value);
+    //rounded to _decimals places, for values that don't need to round-trip
+    void field(const char* _key, double _value, unsigned _decimals);
+    void field(const char* _key, bool _value);
+    void field(const char* _key, const Json::Value& _value);
+    
+    //every member of _object, for requests built as a Json::Value
+    void fields(const Json::Value& _object);
+    
+    void finish(uint32_t _maskingKey);
+    //payload only
+    void finish();
+    
+private:
+    void key(const char* _key, std::size_t _size);
+    void string(const char* _value, std::size_t _size);
+    void integer(int64_t _value);
+    void unsignedInteger(uint64_t _value);
+    void real(double _value);
+    void fixed(double _value, unsigned _decimals);
+    void value(const Json::Value& _value);
+    
+    std::string& frames;
+    std::size_t frameStart;
+    std::size_t headerSpace;
+    bool firstField = true;
+    bool finished = false;
+};
+
 #pragma GCC visibility pop
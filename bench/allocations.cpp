@@ -0,0 +1,78 @@
+//
+//  allocations.cpp
+//  ObsMessageHandler benchmarks
+//
+//  Counts operator new calls per GetStats round trip against bench/fakeobs, on the calling thread and in
+//  the whole process (which includes parsing the response on the io thread), for the future returning
+//  r_GetStats() and for sendRequest(ConstantRequest::GetStats) with a callback.
+//
+//  g++ -std=gnu++14 -O2 -Dmain=example_main -I/usr/include/jsoncpp/json -c ObsMessageHandler/ObsMessageHandler.cpp -o ObsMessageHandler.o
+//  g++ -std=gnu++14 -O2 -IObsMessageHandler -I/usr/include/jsoncpp/json bench/allocations.cpp ObsMessageHandler.o -o allocations -ljsoncpp -lcrypto -lpthread
+//  ./allocations
+//
+
+#include "ObsMessageHandler.hpp"
+#include <iostream>
+#include <cstdlib>
+
+static thread_local long threadAllocations = 0;
+static std::atomic<long> processAllocations{0};
+
+void* operator new(std::size_t _size)
+{
+    threadAllocations++;
+    processAllocations++;
+    
+    void* pointer = std::malloc(_size != 0 ? _size : 1);
+    if(!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void operator delete(void* _pointer) noexcept { std::free(_pointer); }
+void operator delete(void* _pointer, std::size_t) noexcept { std::free(_pointer); }
+
+template<class RoundTrip>
+static void measure(const char* _name, const RoundTrip& _roundTrip)
+{
+    const int warmUp = 1000;
+    const int calls = 20000;
+    
+    for(int i = 0; i < warmUp; i++) _roundTrip();
+    
+    const long thread = threadAllocations;
+    const long process = processAllocations;
+    const auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < calls; i++) _roundTrip();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::cout << _name << ": " << double(threadAllocations - thread) / calls << " allocations per call on the caller thread, "
+              << double(processAllocations - process) / calls << " in the process, " << seconds * 1e6 / calls << " us per round trip" << std::endl;
+}
+
+int main()
+{
+    std::string ip = "127.0.0.1";
+    std::string port = "4455";
+    ObsMessageHandler handler;
+    if(!handler.connect(ip, port)) return 1;
+    handler.recieveUsingThread();
+    
+    measure("r_GetStats()", [&handler]
+    {
+        handler.r_GetStats().get();
+    });
+    
+    std::atomic<int> completed{0};
+    measure("sendRequest(ConstantRequest::GetStats, callback)", [&handler, &completed]
+    {
+        const int before = completed;
+        handler.sendRequest(ConstantRequest::GetStats, [&completed](const ObsMessage&, std::exception_ptr)
+        {
+            completed++;
+        });
+        while(completed == before) std::this_thread::yield();
+    });
+    
+    //skips the handler's close handshake, only the round trips are measured
+    std::exit(0);
+}
@@ -0,0 +1,92 @@
+//
+//  backlog.cpp
+//  ObsMessageHandler benchmarks
+//
+//  Lets 1000 to 64000 small SwitchScenes events pile up in easywsclient's receive buffer, then times the one
+//  dispatch() that drains them. A server thread in the same process writes the events as fast as it can, so
+//  the backlog only depends on how many are asked for.
+//
+//  g++ -std=gnu++14 -O2 -I. bench/backlog.cpp easywsclient.cpp -o backlog -lpthread
+//  ./backlog
+//
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include "easywsclient.hpp"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+//every message received is a count, answered with that many events in a row
+static void emitEvents(tcp::acceptor& _acceptor)
+{
+    try
+    {
+        tcp::socket socket(_acceptor.get_executor());
+        _acceptor.accept(socket);
+        websocket::stream<tcp::socket> ws(std::move(socket));
+        ws.accept();
+        ws.text(true);
+        
+        beast::flat_buffer buffer;
+        for(;;)
+        {
+            buffer.clear();
+            ws.read(buffer);
+            const int count = std::stoi(beast::buffers_to_string(buffer.data()));
+            
+            for(int i = 0; i < count; i++)
+            {
+                const std::string index = std::to_string(i);
+                ws.write(net::buffer("{\"update-type\":\"SwitchScenes\",\"scene-name\":\"Scene " + index + "\",\"index\":" + index + "}"));
+            }
+        }
+    }
+    catch(const std::exception&)
+    {
+        //the client went away
+    }
+}
+
+int main()
+{
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::address_v4::loopback(), 0));
+    std::thread server(emitEvents, std::ref(acceptor));
+    
+    using easywsclient::WebSocket;
+    WebSocket::pointer ws = WebSocket::from_url("ws://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()));
+    if(!ws) return 1;
+    
+    for(const int count : {1000, 4000, 16000, 64000})
+    {
+        ws->send(std::to_string(count));
+        
+        //only poll() until everything is buffered, nothing is dispatched yet
+        const std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + std::chrono::milliseconds(300 + count / 50);
+        while(std::chrono::steady_clock::now() < until) ws->poll(5);
+        
+        long frames = 0, bytes = 0;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ws->dispatch([&](const std::string& _message)
+        {
+            frames++;
+            bytes += _message.size();
+        });
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        
+        std::cout << frames << " frames, " << bytes / 1024 << " KB: dispatch " << ms << " ms, " << ms * 1e6 / frames << " ns/frame" << std::endl;
+        if(frames != count) std::cout << "expected " << count << " frames" << std::endl;
+    }
+    
+    ws->close();
+    while(ws->getReadyState() != WebSocket::CLOSED) ws->poll(5);
+    delete ws;
+    server.join();
+}
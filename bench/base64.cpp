@@ -0,0 +1,192 @@
+//
+//  base64.cpp
+//  ObsMessageHandler benchmarks
+//
+//  Checks base64_encode and base64_decode against the original bit at a time implementation, whitespace,
+//  padding and illegal characters included, and every SIMD kernel this CPU has against the scalar groups.
+//  Then times both implementations for a 32 byte password digest, a 40 byte geometry string, 1 KB and 4 MB.
+//  Includes the .cpp to reach the kernels, so it is built on its own. Exits 1 on any mismatch.
+//
+//  g++ -std=gnu++14 -O2 -Dmain=example_main -IObsMessageHandler -I/usr/include/jsoncpp/json bench/base64.cpp -o base64 -ljsoncpp -lcrypto -lpthread
+//  ./base64
+//
+
+#include "ObsMessageHandler.cpp"
+#undef main
+
+#include <random>
+
+//the implementation before the kernels, kept as the reference
+static std::string referenceEncode(const std::string& _data)
+{
+    std::string encoded(((_data.size() + 2) / 3) * 4, '=');
+    std::size_t written = 0;
+    int bits = 0;
+    unsigned int accumulator = 0;
+    
+    for(const char c : _data)
+    {
+        accumulator = (accumulator << 8) | (c & 0xffu);
+        bits += 8;
+        while(bits >= 6)
+        {
+            bits -= 6;
+            encoded[written++] = b64_table[(accumulator >> bits) & 0x3fu];
+        }
+    }
+    if(bits > 0)
+    {
+        accumulator <<= 6 - bits;
+        encoded[written++] = b64_table[accumulator & 0x3fu];
+    }
+    
+    return encoded;
+}
+
+static std::string referenceDecode(const std::string& _encoded)
+{
+    std::string decoded;
+    int bits = 0;
+    unsigned int accumulator = 0;
+    
+    for(const char character : _encoded)
+    {
+        const int c = character;
+        if(std::isspace(c) || c == '=') continue;
+        if(c > 127 || c < 0 || reverse_table[c] > 63) throw std::invalid_argument("illegal character");
+        
+        accumulator = (accumulator << 6) | reverse_table[c];
+        bits += 6;
+        if(bits >= 8)
+        {
+            bits -= 8;
+            decoded += static_cast<char>((accumulator >> bits) & 0xffu);
+        }
+    }
+    
+    return decoded;
+}
+
+static std::string randomBytes(std::mt19937& _random, std::size_t _size)
+{
+    std::string bytes(_size, '\0');
+    for(char& c : bytes) c = static_cast<char>(_random());
+    return bytes;
+}
+
+struct Kernel
+{
+    const char* name;
+    EncodeKernel encode;
+    DecodeKernel decode;
+};
+
+static std::vector<Kernel> availableKernels()
+{
+    std::vector<Kernel> kernels;
+#if defined(OBS_BASE64_SIMD)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("ssse3")) kernels.push_back({"ssse3", encodeSsse3, decodeSsse3});
+    if(__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", encodeAvx2, decodeAvx2});
+#endif
+    return kernels;
+}
+
+//a kernel has to leave exactly what the scalar groups would have produced for the part it did
+static bool kernelMatches(const Kernel& _kernel, const std::string& _data, const std::string& _encoded)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(_data.data());
+    std::string encoded(_encoded.size(), '=');
+    const std::size_t encodedRead = _kernel.encode(data, _data.size(), &encoded[0]);
+    if(encodedRead % 3 != 0 || encoded.compare(0, encodedRead / 3 * 4, _encoded, 0, encodedRead / 3 * 4) != 0) return false;
+    
+    //the decoders may store up to 32 bytes past what they report
+    const unsigned char* characters = reinterpret_cast<const unsigned char*>(_encoded.data());
+    std::vector<uint8_t> expected(_encoded.size() + 32), decoded(_encoded.size() + 32);
+    std::size_t expectedRead = 0, expectedWritten = 0, read = 0, written = 0;
+    decodeGroups(characters, _encoded.size(), expected.data(), expectedRead, expectedWritten);
+    _kernel.decode(characters, _encoded.size(), decoded.data(), read, written);
+    if(read > expectedRead || written != read / 4 * 3) return false;
+    
+    decodeGroups(characters, _encoded.size(), decoded.data(), read, written);
+    return read == expectedRead && written == expectedWritten && std::equal(expected.begin(), expected.begin() + written, decoded.begin());
+}
+
+template<class Function>
+static double nanosecondsPerCall(int _iterations, const Function& _function)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int i = 0; i < _iterations; i++) _function();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / _iterations;
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    const std::vector<Kernel> kernels = availableKernels();
+    int failures = 0;
+    
+    for(std::size_t size = 0; size < 300; size++)
+    {
+        for(int repeat = 0; repeat < 20; repeat++)
+        {
+            const std::string data = randomBytes(random, size);
+            const std::string encoded = base64_encode(data);
+            if(encoded != referenceEncode(data) || base64_decode(encoded) != data)
+            {
+                std::cout << "round trip differs at " << size << " bytes" << std::endl;
+                failures++;
+            }
+            
+            for(const Kernel& kernel : kernels)
+            {
+                if(kernelMatches(kernel, data, encoded)) continue;
+                std::cout << kernel.name << " differs from the scalar groups at " << size << " bytes" << std::endl;
+                failures++;
+            }
+            
+            //whitespace is skipped and anything else outside the alphabet throws, wherever it lands
+            std::string malformed = encoded;
+            const char inserted[] = {' ', '\n', '*', static_cast<char>(0xc3)};
+            malformed.insert(malformed.begin() + (malformed.empty() ? 0 : random() % malformed.size()), inserted[random() % 4]);
+            
+            std::string decoded, expected;
+            bool threw = false, expectedThrew = false;
+            try { decoded = base64_decode(malformed); } catch(const std::invalid_argument&) { threw = true; }
+            try { expected = referenceDecode(malformed); } catch(const std::invalid_argument&) { expectedThrew = true; }
+            if(threw != expectedThrew || decoded != expected)
+            {
+                std::cout << "malformed input handled differently at " << size << " bytes" << std::endl;
+                failures++;
+            }
+        }
+    }
+    
+    std::cout << "kernels checked:";
+    for(const Kernel& kernel : kernels) std::cout << " " << kernel.name;
+    std::cout << (kernels.empty() ? " none" : "") << std::endl;
+    
+    const struct { const char* name; std::size_t size; int iterations; } cases[] = {
+        {"32 B digest", 32, 200000},
+        {"40 B geometry", 40, 200000},
+        {"1 KB", 1024, 20000},
+        {"4 MB", 4 << 20, 10}
+    };
+    
+    volatile std::size_t sink = 0;
+    for(const auto& test : cases)
+    {
+        const std::string data = randomBytes(random, test.size);
+        const std::string encoded = base64_encode(data);
+        
+        const double referenceEncodeNs = nanosecondsPerCall(test.iterations, [&]{ sink += referenceEncode(data).size(); });
+        const double referenceDecodeNs = nanosecondsPerCall(test.iterations, [&]{ sink += referenceDecode(encoded).size(); });
+        const double encodeNs = nanosecondsPerCall(test.iterations, [&]{ sink += base64_encode(data).size(); });
+        const double decodeNs = nanosecondsPerCall(test.iterations, [&]{ sink += base64_decode(encoded).size(); });
+        
+        std::cout << test.name << ": encode " << referenceEncodeNs << " -> " << encodeNs << " ns, decode " << referenceDecodeNs << " -> " << decodeNs << " ns" << std::endl;
+    }
+    
+    std::cout << (failures ? "FAIL" : "OK") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+//
+//  broadcastskew.cpp
+//  ObsMessageHandler benchmarks
+//
+//  Fans one 8 KB StampArrival broadcast out to N connections to bench/fakeobs through ObsConnectionManager,
+//  each connection its own sink thread there, and reads back when every copy arrived. Reports the median
+//  over 50 broadcasts of the time from the call to the first arrival and of the spread from first to last.
+//
+//  g++ -std=gnu++14 -O2 -Dmain=example_main -I/usr/include/jsoncpp/json -c ObsMessageHandler/ObsMessageHandler.cpp -o ObsMessageHandler.o
+//  g++ -std=gnu++14 -O2 -IObsMessageHandler -I/usr/include/jsoncpp/json bench/broadcastskew.cpp ObsMessageHandler.o -o broadcastskew -ljsoncpp -lcrypto -lpthread
+//  ./fakeobs & ./broadcastskew [connections, default 100] [manager threads, default 4]
+//
+
+#include "ObsMessageHandler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+static long long nanoseconds(std::chrono::steady_clock::time_point _time)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(_time.time_since_epoch()).count();
+}
+
+static double median(std::vector<double>& _values)
+{
+    std::sort(_values.begin(), _values.end());
+    return _values[_values.size() / 2];
+}
+
+int main(int _argc, char** _argv)
+{
+    const int connections = _argc > 1 ? std::atoi(_argv[1]) : 100;
+    const std::size_t threads = _argc > 2 ? std::atoi(_argv[2]) : 4;
+    
+    ObsConnectionManager manager(threads);
+    for(int i = 0; i < connections; i++) manager.add("127.0.0.1", "4455");
+    
+    //fakeobs stamps the arrival on the same steady clock, both ends run on this machine
+    Json::Value request;
+    request["request-type"] = "StampArrival";
+    Json::Value& data = request["data"];
+    for(int i = 0; i < 200; i++)
+    {
+        data["k" + std::to_string(i)] = i * 0.37;
+        data["s" + std::to_string(i)] = "scene item name " + std::to_string(i);
+    }
+    
+    const int rounds = 50;
+    std::vector<double> firstArrival, spread;
+    for(int round = 0; round < rounds; round++)
+    {
+        const long long start = nanoseconds(std::chrono::steady_clock::now());
+        std::vector<std::future<Json::Value>> responses = manager.broadcast(request);
+        
+        std::vector<long long> arrivals;
+        for(std::future<Json::Value>& response : responses)
+        {
+            try
+            {
+                arrivals.push_back(response.get()["at"].asInt64());
+            }
+            catch(const std::exception& e)
+            {
+                std::cout << e.what() << std::endl;
+                return 1;
+            }
+        }
+        
+        std::sort(arrivals.begin(), arrivals.end());
+        firstArrival.push_back((arrivals.front() - start) / 1e3);
+        spread.push_back((arrivals.back() - arrivals.front()) / 1e3);
+    }
+    
+    std::cout << "broadcast to " << connections << " connections on " << threads << " threads: first arrival " << median(firstArrival) << " us, first->last " << median(spread) << " us" << std::endl;
+    
+    //skips closing every connection, only the broadcasts are measured
+    std::exit(0);
+}
@@ -0,0 +1,131 @@
+//
+//  fakeobs.cpp
+//  ObsMessageHandler benchmarks
+//
+//  Local stand-in for obs-websocket 4.x: every request is answered with status "ok" and its message-id,
+//  GetStats and GetVideoInfo with fixed values. Two requests OBS doesn't have: EmitEvents is answered and then
+//  followed by "count" SceneItemTransformChanged events, StampArrival gets "at", the steady_clock nanoseconds
+//  when its frame was read. One thread per connection, frames are answered in order.
+//
+//  g++ -std=gnu++14 -O2 -I/usr/include/jsoncpp/json bench/fakeobs.cpp -o fakeobs -ljsoncpp -lpthread
+//  ./fakeobs [port, default 4455]
+//
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <json.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+static void answer(const Json::Value& _request, Json::Value& _response, std::chrono::steady_clock::time_point _arrival)
+{
+    const std::string type = _request["request-type"].asString();
+    
+    _response["message-id"] = _request["message-id"];
+    _response["status"] = "ok";
+    
+    if(type == "StampArrival")
+    {
+        _response["at"] = static_cast<Json::Int64>(std::chrono::duration_cast<std::chrono::nanoseconds>(_arrival.time_since_epoch()).count());
+    }
+    else if(type == "GetAuthRequired")
+    {
+        _response["authRequired"] = false;
+    }
+    else if(type == "GetStats")
+    {
+        Json::Value& stats = _response["stats"];
+        stats["fps"] = 60.0;
+        stats["render-total-frames"] = 100;
+        stats["render-missed-frames"] = 0;
+        stats["output-total-frames"] = 5;
+        stats["output-skipped-frames"] = 0;
+        stats["average-frame-time"] = 1.0;
+        stats["cpu-usage"] = 1.5;
+        stats["memory-usage"] = 100.0;
+        stats["free-disk-space"] = 1000.0;
+    }
+    else if(type == "GetVideoInfo")
+    {
+        _response["baseWidth"] = 1920;
+        _response["baseHeight"] = 1080;
+        _response["outputWidth"] = 1280;
+        _response["outputHeight"] = 720;
+        _response["scaleType"] = "VIDEO_SCALE_BICUBIC";
+        _response["fps"] = 60.0;
+        _response["videoFormat"] = "VIDEO_FORMAT_NV12";
+        _response["colorSpace"] = "VIDEO_CS_709";
+        _response["colorRange"] = "VIDEO_RANGE_PARTIAL";
+    }
+}
+
+//what OBS sends while an item is dragged around, "index" counts up from 0
+static void emitEvents(websocket::stream<tcp::socket>& _ws, int _count)
+{
+    for(int i = 0; i < _count; i++)
+    {
+        const std::string index = std::to_string(i);
+        _ws.write(net::buffer("{\"update-type\":\"SceneItemTransformChanged\",\"scene-name\":\"Scene 1\",\"item-name\":\"cam\",\"item-id\":1,\"index\":" + index +
+            ",\"transform\":{\"position\":{\"x\":" + index + ",\"y\":540,\"alignment\":5},\"rotation\":0,\"scale\":{\"x\":1,\"y\":1}}}"));
+    }
+}
+
+static void session(tcp::socket _socket)
+{
+    try
+    {
+        _socket.set_option(tcp::no_delay(true));
+        websocket::stream<tcp::socket> ws(std::move(_socket));
+        ws.accept();
+        ws.text(true);
+        
+        Json::CharReaderBuilder readerBuilder;
+        std::unique_ptr<Json::CharReader> reader(readerBuilder.newCharReader());
+        Json::StreamWriterBuilder writerBuilder;
+        writerBuilder["indentation"] = "";
+        
+        beast::flat_buffer buffer;
+        for(;;)
+        {
+            buffer.clear();
+            ws.read(buffer);
+            const std::chrono::steady_clock::time_point arrival = std::chrono::steady_clock::now();
+            
+            const char* data = static_cast<const char*>(buffer.data().data());
+            Json::Value request;
+            std::string error;
+            if(!reader->parse(data, data + buffer.size(), &request, &error)) continue;
+            
+            Json::Value response;
+            answer(request, response, arrival);
+            ws.write(net::buffer(Json::writeString(writerBuilder, response)));
+            
+            if(request["request-type"] == "EmitEvents") emitEvents(ws, request["count"].asInt());
+        }
+    }
+    catch(const std::exception&)
+    {
+        //the client went away
+    }
+}
+
+int main(int _argc, char** _argv)
+{
+    net::io_context ioc;
+    tcp::acceptor acceptor(ioc, tcp::endpoint(tcp::v4(), static_cast<unsigned short>(_argc > 1 ? std::atoi(_argv[1]) : 4455)));
+    
+    for(;;)
+    {
+        tcp::socket socket(ioc);
+        acceptor.accept(socket);
+        std::thread(session, std::move(socket)).detach();
+    }
+}
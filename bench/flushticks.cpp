@@ -0,0 +1,57 @@
+//
+//  flushticks.cpp
+//  ObsMessageHandler benchmarks
+//
+//  200 ticks of 50 SetSceneItemProperties each, every tick waits for all of its responses. Run it once per
+//  flush mode under syscallcount.so to see how many socket writes a tick costs, against bench/fakeobs.
+//
+//  g++ -std=gnu++14 -O2 -Dmain=example_main -I/usr/include/jsoncpp/json -c ObsMessageHandler/ObsMessageHandler.cpp -o ObsMessageHandler.o
+//  g++ -std=gnu++14 -O2 -IObsMessageHandler -I/usr/include/jsoncpp/json bench/flushticks.cpp ObsMessageHandler.o -o flushticks -ljsoncpp -lcrypto -lpthread
+//  LD_PRELOAD=./syscallcount.so ./flushticks [immediate|window|manual]
+//
+
+#include "ObsMessageHandler.hpp"
+#include <iostream>
+#include <cstring>
+
+int main(int _argc, char** _argv)
+{
+    const char* mode = _argc > 1 ? _argv[1] : "immediate";
+    const bool manual = std::strcmp(mode, "manual") == 0;
+    
+    std::string ip = "127.0.0.1";
+    std::string port = "4455";
+    ObsMessageHandler handler;
+    if(!handler.connect(ip, port)) return 1;
+    handler.recieveUsingThread();
+    
+    if(std::strcmp(mode, "window") == 0) handler.setFlushMode(FlushMode::Window, std::chrono::microseconds(100));
+    if(manual) handler.setFlushMode(FlushMode::Manual);
+    
+    const int ticks = 200;
+    const int requestsPerTick = 50;
+    const auto start = std::chrono::steady_clock::now();
+    for(int tick = 0; tick < ticks; tick++)
+    {
+        std::vector<std::future<Json::Value>> responses;
+        for(int i = 0; i < requestsPerTick; i++)
+        {
+            Json::Value request;
+            request["request-type"] = "SetSceneItemProperties";
+            request["scene-name"] = "Scene 1";
+            request["item"] = "cam" + std::to_string(i);
+            request["position.x"] = tick;
+            request["position.y"] = i;
+            responses.push_back(handler.sendRequest(request));
+        }
+        if(manual) handler.flush();
+        
+        for(std::future<Json::Value>& response : responses) response.get();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    std::cout << mode << ": " << ticks * requestsPerTick << " requests in " << ticks << " ticks, " << seconds * 1000 << " ms (" << seconds * 1e6 / ticks << " us/tick)" << std::endl;
+    
+    //skips the handler's close handshake, only the ticks are measured
+    std::exit(0);
+}
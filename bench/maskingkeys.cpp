@@ -0,0 +1,295 @@
+//
+//  maskingkeys.cpp
+//  ObsMessageHandler benchmarks
+//
+//  Sends text, shared and binary frames of 0 B to 3 MB through easywsclient to a raw sink in the same process,
+//  which unmasks them itself. It checks every frame and the close frame came masked, that each payload
+//  round trips, that no frame reuses the key before it and that two connections don't share a key stream.
+//  Then times _MaskingKeys::next() against copying the constant key {0x12, 0x34, 0x56, 0x78} it replaced,
+//  next to what a masked send() of 16 B to 16 KB costs queued without polling, best of 7 connections.
+//  Includes the .cpp to reach _MaskingKeys, so it is built on its own. POSIX sockets only. Exits 1 on any
+//  mismatch.
+//
+//  g++ -std=gnu++14 -O2 -I. bench/maskingkeys.cpp -o maskingkeys -lpthread
+//  ./maskingkeys
+//
+
+#include "easywsclient.cpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using easywsclient::WebSocket;
+
+struct Frame
+{
+    int opcode;
+    bool masked;
+    uint32_t key;
+    std::string payload;
+};
+
+static bool readAll(int _fd, void* _data, std::size_t _size)
+{
+    uint8_t* data = static_cast<uint8_t*>(_data);
+    while(_size > 0)
+    {
+        const ssize_t got = recv(_fd, data, _size, 0);
+        if(got <= 0) return false;
+        data += got;
+        _size -= got;
+    }
+    
+    return true;
+}
+
+//answers the upgrade without checking it, easywsclient doesn't verify Sec-WebSocket-Accept either
+static bool acceptUpgrade(int _fd)
+{
+    std::string request;
+    char c;
+    while(request.size() < 4 || request.compare(request.size() - 4, 4, "\r\n\r\n") != 0)
+    {
+        if(!readAll(_fd, &c, 1)) return false;
+        request += c;
+    }
+    
+    const char response[] = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n\r\n";
+    return send(_fd, response, sizeof(response) - 1, 0) == static_cast<ssize_t>(sizeof(response) - 1);
+}
+
+//one connection up to its close frame or EOF, every frame unmasked here rather than by the code under test
+static void receiveFrames(int _listener, std::vector<Frame>& _frames)
+{
+    const int fd = accept(_listener, NULL, NULL);
+    if(fd < 0 || !acceptUpgrade(fd))
+    {
+        if(fd >= 0) close(fd);
+        return;
+    }
+    
+    uint8_t header[14];
+    while(readAll(fd, header, 2))
+    {
+        Frame frame;
+        frame.opcode = header[0] & 0x0f;
+        frame.masked = (header[1] & 0x80) != 0;
+        uint64_t size = header[1] & 0x7f;
+        const int extended = size == 126 ? 2 : size == 127 ? 8 : 0;
+        if(extended && !readAll(fd, header + 2, extended)) break;
+        if(extended) size = 0;
+        for(int i = 0; i < extended; i++) size = (size << 8) | header[2 + i];
+        
+        uint8_t key[4] = {0, 0, 0, 0};
+        if(frame.masked && !readAll(fd, key, 4)) break;
+        frame.key = (uint32_t(key[0]) << 24) | (uint32_t(key[1]) << 16) | (uint32_t(key[2]) << 8) | key[3];
+        
+        frame.payload.resize(size);
+        if(size > 0 && !readAll(fd, &frame.payload[0], size)) break;
+        for(std::size_t i = 0; i < size; i++) frame.payload[i] ^= key[i & 3];
+        
+        _frames.push_back(std::move(frame));
+        if((header[0] & 0x0f) == 0x8) break;
+    }
+    
+    close(fd);
+}
+
+//the benchmark's side, read and dropped until the client closes
+static void discardFrames(int _listener)
+{
+    const int fd = accept(_listener, NULL, NULL);
+    if(fd < 0) return;
+    
+    static uint8_t buffer[1 << 16];
+    if(acceptUpgrade(fd))
+    {
+        while(recv(fd, buffer, sizeof(buffer), 0) > 0) { }
+    }
+    
+    close(fd);
+}
+
+static int listenLocal(int& _port)
+{
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if(listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 16) != 0) return -1;
+    
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+    _port = ntohs(address.sin_port);
+    return listener;
+}
+
+static std::string payload(std::size_t _size, int _index)
+{
+    std::string data(_size, '\0');
+    for(std::size_t i = 0; i < _size; i++) data[i] = static_cast<char>((i * 131 + _size + _index) & 0xff);
+    return data;
+}
+
+static void closeAndDrain(WebSocket::pointer _ws)
+{
+    _ws->close();
+    while(_ws->getReadyState() != WebSocket::CLOSED) _ws->poll(10);
+    delete _ws;
+}
+
+//every frame goes out, in order, through each of the three send paths
+static std::vector<std::string> sendFrames(const std::string& _url)
+{
+    std::vector<std::string> sent;
+    WebSocket::pointer ws = WebSocket::from_url(_url);
+    if(!ws) return sent;
+    
+    const std::size_t sizes[] = {0, 1, 125, 126, 1023, 1024, 65535, 65536, 200000, 3u << 20};
+    int index = 0;
+    for(int round = 0; round < 20; round++)
+    {
+        for(const std::size_t size : sizes)
+        {
+            for(int path = 0; path < 3; path++, index++)
+            {
+                std::string data = payload(round < 2 || size < 65536 ? size : 16, index);
+                sent.push_back(data);
+                if(path == 0) ws->send(data);
+                else if(path == 1) ws->send(std::make_shared<const std::string>(data));
+                else ws->sendBinary(std::make_shared<const std::vector<uint8_t>>(data.begin(), data.end()));
+                ws->poll(0);
+            }
+        }
+    }
+    
+    closeAndDrain(ws);
+    return sent;
+}
+
+int main()
+{
+    int port = 0;
+    const int listener = listenLocal(port);
+    if(listener < 0) return 1;
+    const std::string url = "ws://127.0.0.1:" + std::to_string(port);
+    
+    int failures = 0;
+    std::vector<Frame> connections[2];
+    std::vector<std::string> sent;
+    for(std::vector<Frame>& frames : connections)
+    {
+        std::thread sink(receiveFrames, listener, std::ref(frames));
+        sent = sendFrames(url);
+        sink.join();
+        
+        if(frames.size() != sent.size() + 1 || frames.back().opcode != 0x8)
+        {
+            std::printf("%zu frames and a close sent, %zu received\n", sent.size(), frames.size());
+            failures++;
+            continue;
+        }
+        
+        std::set<uint32_t> keys;
+        for(std::size_t i = 0; i < frames.size(); i++)
+        {
+            const bool intact = i == sent.size() || frames[i].payload == sent[i];
+            if(!frames[i].masked || !intact || (i > 0 && frames[i].key == frames[i - 1].key))
+            {
+                std::printf("frame %zu: masked %d, intact %d, key %08x after %08x\n", i, frames[i].masked, intact, frames[i].key, i > 0 ? frames[i - 1].key : 0);
+                failures++;
+            }
+            keys.insert(frames[i].key);
+        }
+        
+        std::printf("%zu frames round tripped, %zu distinct keys, close frame key %08x\n", sent.size(), keys.size(), frames.back().key);
+    }
+    
+    //seeded separately, so the streams don't start alike
+    if(connections[0].size() > 16 && connections[1].size() > 16)
+    {
+        int shared = 0;
+        for(std::size_t i = 0; i < 16; i++) shared += connections[0][i].key == connections[1][i].key;
+        if(shared > 0)
+        {
+            std::printf("the two connections share %d of their first 16 keys\n", shared);
+            failures++;
+        }
+    }
+    
+    //a key from the stream against the constant key every frame used to get, the asm keeps either from being folded
+    const uint8_t constantKey[4] = {0x12, 0x34, 0x56, 0x78};
+    const int keyCount = 1 << 24;
+    double nextNs = 1e18, constantNs = 1e18;
+    for(int repeat = 0; repeat < 7; repeat++)
+    {
+        _MaskingKeys keys;
+        if(!keys.seed()) return 1;
+        
+        uint8_t key[4];
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(int i = 0; i < keyCount; i++)
+        {
+            keys.next(key);
+            asm volatile("" : : "r"(key) : "memory");
+        }
+        const std::chrono::steady_clock::time_point streamDone = std::chrono::steady_clock::now();
+        for(int i = 0; i < keyCount; i++)
+        {
+            std::memcpy(key, constantKey, 4);
+            asm volatile("" : : "r"(key) : "memory");
+        }
+        const std::chrono::steady_clock::time_point constantDone = std::chrono::steady_clock::now();
+        
+        nextNs = std::min(nextNs, std::chrono::duration<double, std::nano>(streamDone - start).count() / keyCount);
+        constantNs = std::min(constantNs, std::chrono::duration<double, std::nano>(constantDone - streamDone).count() / keyCount);
+    }
+    
+    std::printf("key stream %.2f ns/key, constant key %.2f ns/key\n", nextNs, constantNs);
+    
+    //the sink only drains from here on, one connection per timed run
+    const std::size_t sizes[] = {16, 125, 1024, 16384};
+    const int repeats = 7;
+    std::thread sink([&]
+    {
+        for(std::size_t i = 0; i < repeats * sizeof(sizes) / sizeof(sizes[0]); i++) discardFrames(listener);
+    });
+    
+    for(const std::size_t size : sizes)
+    {
+        double best = 1e18;
+        for(int repeat = 0; repeat < repeats; repeat++)
+        {
+            WebSocket::pointer ws = WebSocket::from_url(url);
+            if(!ws) std::exit(1);
+            
+            const std::string message(size, 'x');
+            const int count = static_cast<int>(std::min<std::size_t>(100000, (16u << 20) / size));
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for(int i = 0; i < count; i++) ws->send(message);
+            best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count);
+            
+            closeAndDrain(ws);
+        }
+        
+        std::printf("%6zu B: masked send %.1f ns/frame, the key stream adds %.2f ns (%.1f%%)\n", size, best, nextNs - constantNs, 100 * (nextNs - constantNs) / best);
+    }
+    
+    sink.join();
+    close(listener);
+    
+    std::printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+//
+//  readthroughput.cpp
+//  ObsMessageHandler benchmarks
+//
+//  Asks bench/fakeobs for bursts of 1000 to 200000 SceneItemTransformChanged events and times how long the
+//  read side takes to hand all of them to an onEvent handler, from sending EmitEvents to the last event.
+//  Each burst is run 3 times and the best is reported in messages per second.
+//
+//  g++ -std=gnu++14 -O2 -Dmain=example_main -I/usr/include/jsoncpp/json -c ObsMessageHandler/ObsMessageHandler.cpp -o ObsMessageHandler.o
+//  g++ -std=gnu++14 -O2 -IObsMessageHandler -I/usr/include/jsoncpp/json bench/readthroughput.cpp ObsMessageHandler.o -o readthroughput -ljsoncpp -lcrypto -lpthread
+//  ./fakeobs & ./readthroughput
+//
+
+#include "ObsMessageHandler.hpp"
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+
+int main()
+{
+    std::string ip = "127.0.0.1";
+    std::string port = "4455";
+    ObsMessageHandler handler;
+    if(!handler.connect(ip, port)) return 1;
+    handler.recieveUsingThread();
+    
+    std::mutex mutex;
+    std::condition_variable lastEvent;
+    int remaining = 0;
+    handler.onEvent(ObsEventType::SceneItemTransformChanged, [&](const ObsMessage&)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--remaining == 0) lastEvent.notify_one();
+    });
+    
+    for(const int count : {1000, 10000, 50000, 200000})
+    {
+        double best = 1e18;
+        for(int repeat = 0; repeat < 3; repeat++)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                remaining = count;
+            }
+            
+            Json::Value request;
+            request["request-type"] = "EmitEvents";
+            request["count"] = count;
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            handler.sendRequest(request);
+            
+            std::unique_lock<std::mutex> lock(mutex);
+            if(!lastEvent.wait_for(lock, std::chrono::seconds(60), [&]{ return remaining == 0; }))
+            {
+                std::cout << count - remaining << " of " << count << " events arrived" << std::endl;
+                return 1;
+            }
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        
+        std::cout << count << " events: " << best * 1000 << " ms, " << static_cast<long>(count / best) << " msg/s" << std::endl;
+    }
+    
+    //skips the handler's close handshake, only the reads are measured
+    std::exit(0);
+}
@@ -0,0 +1,81 @@
+/*
+ *  syscallcount.c
+ *  ObsMessageHandler benchmarks
+ *
+ *  LD_PRELOAD shim that counts the socket write and read calls of a process and prints them at exit.
+ *
+ *  gcc -O2 -shared -fPIC bench/syscallcount.c -o syscallcount.so -ldl
+ *  LD_PRELOAD=./syscallcount.so ./flushticks immediate
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static long sendmsgCalls, sendCalls, writevCalls, writeCalls, recvmsgCalls, recvCalls, readCalls;
+
+static void report(void)
+{
+    fprintf(stderr, "[syscalls] sendmsg=%ld send=%ld writev=%ld write=%ld recvmsg=%ld recv=%ld read=%ld\n",
+            sendmsgCalls, sendCalls, writevCalls, writeCalls, recvmsgCalls, recvCalls, readCalls);
+}
+
+__attribute__((constructor)) static void install(void)
+{
+    atexit(report);
+}
+
+#define NEXT(name) static __typeof__(name)* next; if(!next) next = (__typeof__(name)*)dlsym(RTLD_NEXT, #name)
+
+ssize_t sendmsg(int _fd, const struct msghdr* _message, int _flags)
+{
+    NEXT(sendmsg);
+    __sync_fetch_and_add(&sendmsgCalls, 1);
+    return next(_fd, _message, _flags);
+}
+
+ssize_t send(int _fd, const void* _buffer, size_t _size, int _flags)
+{
+    NEXT(send);
+    __sync_fetch_and_add(&sendCalls, 1);
+    return next(_fd, _buffer, _size, _flags);
+}
+
+ssize_t writev(int _fd, const struct iovec* _iov, int _count)
+{
+    NEXT(writev);
+    __sync_fetch_and_add(&writevCalls, 1);
+    return next(_fd, _iov, _count);
+}
+
+ssize_t write(int _fd, const void* _buffer, size_t _size)
+{
+    NEXT(write);
+    __sync_fetch_and_add(&writeCalls, 1);
+    return next(_fd, _buffer, _size);
+}
+
+ssize_t recvmsg(int _fd, struct msghdr* _message, int _flags)
+{
+    NEXT(recvmsg);
+    __sync_fetch_and_add(&recvmsgCalls, 1);
+    return next(_fd, _message, _flags);
+}
+
+ssize_t recv(int _fd, void* _buffer, size_t _size, int _flags)
+{
+    NEXT(recv);
+    __sync_fetch_and_add(&recvCalls, 1);
+    return next(_fd, _buffer, _size, _flags);
+}
+
+ssize_t read(int _fd, void* _buffer, size_t _size)
+{
+    NEXT(read);
+    __sync_fetch_and_add(&readCalls, 1);
+    return next(_fd, _buffer, _size);
+}
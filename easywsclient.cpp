@@ -9,7 +9,9 @@
     #include <fcntl.h>
     #include <WinSock2.h>
     #include <WS2tcpip.h>
+    #include <bcrypt.h>
     #pragma comment( lib, "ws2_32" )
+    #pragma comment( lib, "bcrypt" )
     #include <stdio.h>
     #include <stdlib.h>
     #include <string.h>
@@ -50,6 +52,7 @@
     #include <sys/socket.h>
     #include <sys/time.h>
     #include <sys/types.h>
+    #include <sys/uio.h>
     #include <unistd.h>
     #include <stdint.h>
     #ifndef _SOCKET_T_DEFINED
@@ -64,6 +67,14 @@
     #endif
     #define closesocket(s) ::close(s)
     #include <errno.h>
+    #if defined(__linux__)
+        #include <sys/epoll.h>
+        #include <sys/random.h>
+        #define EASYWSCLIENT_EPOLL
+    #elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+        #include <sys/event.h>
+        #define EASYWSCLIENT_KQUEUE
+    #endif
     #define socketerrno errno
     #define SOCKET_EAGAIN_EINPROGRESS EAGAIN
     #define SOCKET_EWOULDBLOCK EWOULDBLOCK
@@ -71,8 +82,12 @@
 
 #include <vector>
 #include <string>
+#include <deque>
+#include <memory>
+#include <algorithm>
 
 #include "easywsclient.hpp"
+#include "websocketmask.hpp"
 
 using easywsclient::Callback_Imp;
 using easywsclient::BytesCallback_Imp;
@@ -109,6 +124,100 @@ socket_t hostname_connect(const std::string& hostname, int port) {
     return sockfd;
 }
 
+// Fills `out` from the operating system's CSPRNG:
+bool system_random(uint8_t * out, size_t size) {
+#if defined(_WIN32)
+    return BCryptGenRandom(NULL, out, (ULONG) size, BCRYPT_USE_SYSTEM_PREFERRED_RNG) == 0;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    arc4random_buf(out, size);
+    return true;
+#else
+#if defined(__linux__)
+    while (size > 0) {
+        ssize_t ret = getrandom(out, size, 0);
+        if (ret < 0 && errno == EINTR) { continue; }
+        if (ret < 0) { break; }
+        out += ret;
+        size -= ret;
+    }
+    if (size == 0) { return true; }
+#endif
+    // Kernels before 3.17 have no getrandom(), other POSIX systems only /dev/urandom:
+    FILE * urandom = fopen("/dev/urandom", "rb");
+    if (urandom == NULL) { return false; }
+    size_t got = fread(out, 1, size, urandom);
+    fclose(urandom);
+    return got == size;
+#endif
+}
+
+// RFC 6455 10.3: masking keys must not be predictable by whoever picks the
+// payload, or the frame could be made to look like something else to a
+// proxy. Every connection runs its own ChaCha20 stream, keyed once from the
+// system and refilled 16 keys at a time, so a key costs a few ns instead of
+// a syscall.
+class _MaskingKeys
+{
+  public:
+    _MaskingKeys() : pos(sizeof(block)) {
+        memset(state, 0, sizeof(state));
+    }
+
+    bool seed() {
+        uint8_t seed[40]; // 256 bit key, 64 bit nonce
+        if (!system_random(seed, sizeof(seed))) { return false; }
+        state[0] = 0x61707865; // "expand 32-byte k"
+        state[1] = 0x3320646e;
+        state[2] = 0x79622d32;
+        state[3] = 0x6b206574;
+        memcpy(state + 4, seed, 32);
+        state[12] = 0; // 64 bit block counter
+        state[13] = 0;
+        memcpy(state + 14, seed + 32, 8);
+        pos = sizeof(block);
+        return true;
+    }
+
+    void next(uint8_t key[4]) {
+        if (pos == sizeof(block)) { refill(); }
+        memcpy(key, block + pos, 4);
+        pos += 4;
+    }
+
+  private:
+    static uint32_t rotl(uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+    static void quarterRound(uint32_t * x, int a, int b, int c, int d) {
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+    }
+
+    void refill() {
+        uint32_t x[16];
+        memcpy(x, state, sizeof(x));
+        for (int i = 0; i < 10; ++i) {
+            quarterRound(x, 0, 4,  8, 12);
+            quarterRound(x, 1, 5,  9, 13);
+            quarterRound(x, 2, 6, 10, 14);
+            quarterRound(x, 3, 7, 11, 15);
+            quarterRound(x, 0, 5, 10, 15);
+            quarterRound(x, 1, 6, 11, 12);
+            quarterRound(x, 2, 7,  8, 13);
+            quarterRound(x, 3, 4,  9, 14);
+        }
+        for (int i = 0; i < 16; ++i) { x[i] += state[i]; }
+        memcpy(block, x, sizeof(block));
+        if (++state[12] == 0) { ++state[13]; }
+        pos = 0;
+    }
+
+    uint32_t state[16];
+    uint8_t block[64];
+    size_t pos; // block[pos, 64) is unused
+};
+
 
 class _DummyWebSocket : public easywsclient::WebSocket
 {
@@ -117,6 +226,8 @@ class _DummyWebSocket : public easywsclient::WebSocket
     void send(const std::string& message) { }
     void sendBinary(const std::string& message) { }
     void sendBinary(const std::vector<uint8_t>& message) { }
+    void send(const std::shared_ptr<const std::string>&) { }
+    void sendBinary(const std::shared_ptr<const std::vector<uint8_t> >&) { }
     void sendPing() { }
     void close() { } 
     readyStateValues getReadyState() const { return CLOSED; }
@@ -165,26 +276,82 @@ class _RealWebSocket : public easywsclient::WebSocket
         uint8_t masking_key[4];
     };
 
+    // rxbuf only grows, its size is the room reads can fill and rxend how far
+    // they have, so a large frame doesn't zero the buffer again for every read:
     std::vector<uint8_t> rxbuf;
+    size_t rxpos; // rxbuf[rxpos, rxend) is unparsed, frames are consumed by moving the cursor
+    size_t rxend;
+    // Outgoing bytes: headers, control frames and masked payloads are copied
+    // into txbuf, unmasked payloads of shared buffers are only referenced.
+    // txrefs[i] goes out once txbuf has been sent up to txrefs[i].offset.
+    struct txref {
+        size_t offset;
+        std::shared_ptr<const void> owner; // empty while the caller's buffer is borrowed inside sendData()
+        const uint8_t * data;
+        size_t size;
+    };
     std::vector<uint8_t> txbuf;
+    size_t txpos; // txbuf[0, txpos) is sent
+    std::deque<txref> txrefs;
     std::vector<uint8_t> receivedData;
 
     socket_t sockfd;
     readyStateValues readyState = CLOSED;
     bool useMask;
+    _MaskingKeys maskingKeys; // seeded when useMask
     bool isRxBad;
+    easywsclient::TransportStats stats;
+
+    // Set while registered with a Reactor, which only learns about edges and
+    // so has to be told when there is something new to send:
+    std::vector<_RealWebSocket *> * writeQueue;
+    bool queuedForWrite;
+    bool queuedForDispatch;
 
-    _RealWebSocket(socket_t sockfd, bool useMask)
-            : sockfd(sockfd)
+    _RealWebSocket(socket_t sockfd, bool useMask, const _MaskingKeys& maskingKeys)
+            : rxpos(0)
+            , rxend(0)
+            , txpos(0)
+            , sockfd(sockfd)
             , readyState(OPEN)
             , useMask(useMask)
-            , isRxBad(false) {
+            , maskingKeys(maskingKeys)
+            , isRxBad(false)
+            , writeQueue(NULL)
+            , queuedForWrite(false)
+            , queuedForDispatch(false) {
+        memset(&stats, 0, sizeof(stats));
     }
 
     readyStateValues getReadyState() const {
       return readyState;
     }
 
+    easywsclient::TransportStats getStats() const {
+      return stats;
+    }
+
+    // Bytes still missing from the frame at rxpos, as far as its header is in:
+    size_t missingFrameBytes() const {
+        const size_t available = rxend - rxpos;
+        if (available < 2) { return 0; }
+        const uint8_t * data = &rxbuf[rxpos];
+        const int N0 = data[1] & 0x7f;
+        const size_t header_size = 2 + (N0 == 126? 2 : 0) + (N0 == 127? 8 : 0) + ((data[1] & 0x80)? 4 : 0);
+        if (available < header_size) { return header_size - available; }
+        uint64_t N = N0;
+        if (N0 == 126) {
+            N = ((uint64_t) data[2] << 8) | data[3];
+        }
+        else if (N0 == 127) {
+            N = 0;
+            for (int i = 2; i < 10; ++i) { N = (N << 8) | data[i]; }
+        }
+        // Bogus lengths are rejected by _dispatchBinary, just don't allocate for them:
+        if (N > (1u << 26)) { N = 1u << 26; }
+        return header_size + N > available ? header_size + N - available : 0;
+    }
+
     void poll(int timeout) { // timeout in milliseconds
         if (readyState == CLOSED) {
             if (timeout > 0) {
@@ -200,34 +367,128 @@ class _RealWebSocket : public easywsclient::WebSocket
             FD_ZERO(&rfds);
             FD_ZERO(&wfds);
             FD_SET(sockfd, &rfds);
-            if (txbuf.size()) { FD_SET(sockfd, &wfds); }
+            if (hasPendingTx()) { FD_SET(sockfd, &wfds); }
             select(sockfd + 1, &rfds, &wfds, 0, timeout > 0 ? &tv : 0);
         }
+        // Reclaim the consumed front only once it outweighs what is left, so
+        // every byte is moved at most once on average:
+        if (rxpos > 0 && rxpos >= rxend - rxpos) {
+            memmove(&rxbuf[0], &rxbuf[0] + rxpos, rxend - rxpos);
+            rxend -= rxpos;
+            rxpos = 0;
+        }
         while (true) {
             // FD_ISSET(0, &rfds) will be true
-            int N = rxbuf.size();
+            // Each read has room for at least the rest of the frame in flight and
+            // goes straight into rxbuf, whatever else the socket holds spills into
+            // the overflow buffer of the same readv, so a multi-MB response costs
+            // a handful of syscalls:
+            size_t want = missingFrameBytes();
+            if (want < 1500) { want = 1500; }
+            if (rxbuf.size() - rxend < want) { rxbuf.resize(std::max(rxend + want, rxbuf.size() * 2)); }
+            const size_t room = rxbuf.size() - rxend;
             ssize_t ret;
-            rxbuf.resize(N + 1500);
-            ret = recv(sockfd, (char*)&rxbuf[0] + N, 1500, 0);
+#ifdef _WIN32
+            const size_t overflowSize = 0;
+            ret = recv(sockfd, (char*)&rxbuf[0] + rxend, (int) room, 0);
+#else
+            uint8_t overflow[65536];
+            const size_t overflowSize = sizeof(overflow);
+            iovec iov[2];
+            iov[0].iov_base = &rxbuf[0] + rxend;
+            iov[0].iov_len = room;
+            iov[1].iov_base = overflow;
+            iov[1].iov_len = overflowSize;
+            ret = readv(sockfd, iov, 2);
+#endif
+            ++stats.recvCalls;
             if (false) { }
             else if (ret < 0 && (socketerrno == SOCKET_EWOULDBLOCK || socketerrno == SOCKET_EAGAIN_EINPROGRESS)) {
-                rxbuf.resize(N);
                 break;
             }
             else if (ret <= 0) {
-                rxbuf.resize(N);
                 closesocket(sockfd);
                 readyState = CLOSED;
                 fputs(ret < 0 ? "Connection error!\n" : "Connection closed!\n", stderr);
                 break;
             }
             else {
-                rxbuf.resize(N + ret);
+                stats.bytesReceived += ret;
+                if ((size_t) ret <= room) {
+                    rxend += ret;
+                }
+                else {
+#ifndef _WIN32
+                    // Only once rxbuf is full, which its doubling keeps rare:
+                    const size_t spilled = ret - room;
+                    rxend = rxbuf.size();
+                    rxbuf.resize(std::max(rxend + spilled, rxbuf.size() * 2));
+                    memcpy(&rxbuf[0] + rxend, overflow, spilled);
+                    rxend += spilled;
+#endif
+                }
+                // A short read on a stream socket means it is drained, no need
+                // to spend another syscall on EAGAIN:
+                if ((size_t) ret < room + overflowSize) { break; }
             }
         }
-        while (txbuf.size()) {
-            int ret = ::send(sockfd, (char*)&txbuf[0], txbuf.size(), 0);
-            if (false) { } // ??
+        flushTx();
+        if (!hasPendingTx() && readyState == CLOSING) {
+            closesocket(sockfd);
+            readyState = CLOSED;
+        }
+    }
+
+    bool hasPendingTx() const {
+        return txpos != txbuf.size() || !txrefs.empty();
+    }
+
+    // Sends as much of the queue as the socket takes, the copied and the
+    // referenced segments gathered into one sendmsg() per round:
+    void flushTx() {
+        while (hasPendingTx() && readyState != CLOSED) {
+#ifdef _WIN32
+            const char * data;
+            size_t size;
+            if (!txrefs.empty() && txpos == txrefs.front().offset) {
+                data = (const char *) txrefs.front().data;
+                size = txrefs.front().size;
+            }
+            else {
+                data = (const char *) &txbuf[txpos];
+                size = (txrefs.empty() ? txbuf.size() : txrefs.front().offset) - txpos;
+            }
+            int ret = ::send(sockfd, data, (int) size, 0);
+#else
+            const int maxSegments = 64;
+            iovec iov[maxSegments];
+            int n = 0;
+            size_t pos = txpos;
+            size_t r = 0;
+            for (; r != txrefs.size() && n + 2 <= maxSegments; ++r) {
+                if (txrefs[r].offset > pos) {
+                    iov[n].iov_base = &txbuf[pos];
+                    iov[n].iov_len = txrefs[r].offset - pos;
+                    ++n;
+                    pos = txrefs[r].offset;
+                }
+                iov[n].iov_base = (void *) txrefs[r].data;
+                iov[n].iov_len = txrefs[r].size;
+                ++n;
+            }
+            if (r == txrefs.size() && pos < txbuf.size()) {
+                iov[n].iov_base = &txbuf[pos];
+                iov[n].iov_len = txbuf.size() - pos;
+                ++n;
+            }
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = n;
+            ssize_t ret = ::sendmsg(sockfd, &msg, 0);
+#endif
+            ++stats.sendCalls;
+            if (false) { }
             else if (ret < 0 && (socketerrno == SOCKET_EWOULDBLOCK || socketerrno == SOCKET_EAGAIN_EINPROGRESS)) {
                 break;
             }
@@ -238,12 +499,32 @@ class _RealWebSocket : public easywsclient::WebSocket
                 break;
             }
             else {
-                txbuf.erase(txbuf.begin(), txbuf.begin() + ret);
+                stats.bytesSent += ret;
+                consumeTx(ret);
             }
         }
-        if (!txbuf.size() && readyState == CLOSING) {
-            closesocket(sockfd);
-            readyState = CLOSED;
+        if (!hasPendingTx()) {
+            txbuf.clear();
+            txpos = 0;
+        }
+    }
+
+    void consumeTx(size_t sent) {
+        while (sent > 0) {
+            if (!txrefs.empty() && txpos == txrefs.front().offset) {
+                txref& ref = txrefs.front();
+                const size_t take = std::min(sent, ref.size);
+                ref.data += take;
+                ref.size -= take;
+                sent -= take;
+                if (ref.size == 0) { txrefs.pop_front(); }
+            }
+            else {
+                const size_t end = txrefs.empty() ? txbuf.size() : txrefs.front().offset;
+                const size_t take = std::min(sent, end - txpos);
+                txpos += take;
+                sent -= take;
+            }
         }
     }
 
@@ -274,14 +555,16 @@ class _RealWebSocket : public easywsclient::WebSocket
         }
         while (true) {
             wsheader_type ws;
-            if (rxbuf.size() < 2) { return; /* Need at least 2 */ }
-            const uint8_t * data = (uint8_t *) &rxbuf[0]; // peek, but don't consume
+            if (rxpos == rxend) { rxend = 0; rxpos = 0; }
+            const size_t available = rxend - rxpos;
+            if (available < 2) { return; /* Need at least 2 */ }
+            uint8_t * data = &rxbuf[rxpos]; // peek, but don't consume
             ws.fin = (data[0] & 0x80) == 0x80;
             ws.opcode = (wsheader_type::opcode_type) (data[0] & 0x0f);
             ws.mask = (data[1] & 0x80) == 0x80;
             ws.N0 = (data[1] & 0x7f);
             ws.header_size = 2 + (ws.N0 == 126? 2 : 0) + (ws.N0 == 127? 8 : 0) + (ws.mask? 4 : 0);
-            if (rxbuf.size() < ws.header_size) { return; /* Need: ws.header_size - rxbuf.size() */ }
+            if (available < ws.header_size) { return; /* Need: ws.header_size - available */ }
             int i = 0;
             if (ws.N0 < 126) {
                 ws.N = ws.N0;
@@ -334,7 +617,9 @@ class _RealWebSocket : public easywsclient::WebSocket
 
             // Note: The checks above should hopefully ensure this addition
             //       cannot overflow:
-            if (rxbuf.size() < ws.header_size+ws.N) { return; /* Need: ws.header_size+ws.N - rxbuf.size() */ }
+            if (available < ws.header_size+ws.N) { return; /* Need: ws.header_size+ws.N - available */ }
+            // Consumed up front, the callback may poll() and compact rxbuf:
+            rxpos += ws.header_size+(size_t)ws.N;
 
             // We got a whole message, now do something with it:
             if (false) { }
@@ -343,8 +628,8 @@ class _RealWebSocket : public easywsclient::WebSocket
                 || ws.opcode == wsheader_type::BINARY_FRAME
                 || ws.opcode == wsheader_type::CONTINUATION
             ) {
-                if (ws.mask) { for (size_t i = 0; i != ws.N; ++i) { rxbuf[i+ws.header_size] ^= ws.masking_key[i&0x3]; } }
-                receivedData.insert(receivedData.end(), rxbuf.begin()+ws.header_size, rxbuf.begin()+ws.header_size+(size_t)ws.N);// just feed
+                if (ws.mask) { websocketmask::mask(data+ws.header_size, data+ws.header_size, (size_t)ws.N, ws.masking_key); }
+                receivedData.insert(receivedData.end(), data+ws.header_size, data+ws.header_size+(size_t)ws.N);// just feed
                 if (ws.fin) {
                     callable((const std::vector<uint8_t>) receivedData);
                     receivedData.erase(receivedData.begin(), receivedData.end());
@@ -352,46 +637,56 @@ class _RealWebSocket : public easywsclient::WebSocket
                 }
             }
             else if (ws.opcode == wsheader_type::PING) {
-                if (ws.mask) { for (size_t i = 0; i != ws.N; ++i) { rxbuf[i+ws.header_size] ^= ws.masking_key[i&0x3]; } }
-                std::string data(rxbuf.begin()+ws.header_size, rxbuf.begin()+ws.header_size+(size_t)ws.N);
-                sendData(wsheader_type::PONG, data.size(), data.begin(), data.end());
+                if (ws.mask) { websocketmask::mask(data+ws.header_size, data+ws.header_size, (size_t)ws.N, ws.masking_key); }
+                sendData(wsheader_type::PONG, data+ws.header_size, (size_t)ws.N, NULL);
             }
             else if (ws.opcode == wsheader_type::PONG) { }
             else if (ws.opcode == wsheader_type::CLOSE) { close(); }
             else { fprintf(stderr, "ERROR: Got unexpected WebSocket message.\n"); close(); }
 
-            rxbuf.erase(rxbuf.begin(), rxbuf.begin() + ws.header_size+(size_t)ws.N);
         }
     }
 
     void sendPing() {
-        std::string empty;
-        sendData(wsheader_type::PING, empty.size(), empty.begin(), empty.end());
+        sendData(wsheader_type::PING, NULL, 0, NULL);
     }
 
     void send(const std::string& message) {
-        sendData(wsheader_type::TEXT_FRAME, message.size(), message.begin(), message.end());
+        sendData(wsheader_type::TEXT_FRAME, (const uint8_t *) message.data(), message.size(), NULL);
     }
 
     void sendBinary(const std::string& message) {
-        sendData(wsheader_type::BINARY_FRAME, message.size(), message.begin(), message.end());
+        sendData(wsheader_type::BINARY_FRAME, (const uint8_t *) message.data(), message.size(), NULL);
     }
 
     void sendBinary(const std::vector<uint8_t>& message) {
-        sendData(wsheader_type::BINARY_FRAME, message.size(), message.begin(), message.end());
+        sendData(wsheader_type::BINARY_FRAME, message.empty() ? NULL : &message[0], message.size(), NULL);
+    }
+
+    void send(const std::shared_ptr<const std::string>& message) {
+        sendData(wsheader_type::TEXT_FRAME, (const uint8_t *) message->data(), message->size(), message);
     }
 
-    template<class Iterator>
-    void sendData(wsheader_type::opcode_type type, uint64_t message_size, Iterator message_begin, Iterator message_end) {
-        // TODO:
-        // Masking key should (must) be derived from a high quality random
-        // number generator, to mitigate attacks on non-WebSocket friendly
-        // middleware:
-        const uint8_t masking_key[4] = { 0x12, 0x34, 0x56, 0x78 };
+    void sendBinary(const std::shared_ptr<const std::vector<uint8_t> >& message) {
+        sendData(wsheader_type::BINARY_FRAME, message->empty() ? NULL : &(*message)[0], message->size(), message);
+    }
+
+    // Below this, copying the payload is cheaper than another segment:
+    static const size_t minReferencedPayload = 1024;
+    // A borrowed payload has to go out before the call returns, and a
+    // write of its own only beats copying it from this size on:
+    static const size_t minImmediatePayload = 65536;
+
+    // The payload comes from the caller's buffer, which is only referenced
+    // while `owner` keeps it alive and only borrowed for the duration of the
+    // call without one:
+    void sendData(wsheader_type::opcode_type type, const uint8_t * message, uint64_t message_size, const std::shared_ptr<const void>& owner) {
         // TODO: consider acquiring a lock on txbuf...
         if (readyState == CLOSING || readyState == CLOSED) { return; }
-        std::vector<uint8_t> header;
-        header.assign(2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) + (useMask ? 4 : 0), 0);
+        uint8_t masking_key[4];
+        if (useMask) { maskingKeys.next(masking_key); }
+        uint8_t header[14];
+        const size_t header_size = 2 + (message_size >= 126 ? 2 : 0) + (message_size >= 65536 ? 6 : 0) + (useMask ? 4 : 0);
         header[0] = 0x80 | type;
         if (false) { }
         else if (message_size < 126) {
@@ -431,27 +726,198 @@ class _RealWebSocket : public easywsclient::WebSocket
                 header[13] = masking_key[3];
             }
         }
+        // Reclaim what was sent once it outweighs what is still queued:
+        if (txpos > 0 && txpos >= txbuf.size() - txpos) {
+            txbuf.erase(txbuf.begin(), txbuf.begin() + txpos);
+            for (size_t i = 0; i != txrefs.size(); ++i) { txrefs[i].offset -= txpos; }
+            txpos = 0;
+        }
         // N.B. - txbuf will keep growing until it can be transmitted over the socket:
-        txbuf.insert(txbuf.end(), header.begin(), header.end());
-        txbuf.insert(txbuf.end(), message_begin, message_end);
+        txbuf.insert(txbuf.end(), header, header + header_size);
         if (useMask) {
-            size_t message_offset = txbuf.size() - message_size;
-            for (size_t i = 0; i != message_size; ++i) {
-                txbuf[message_offset + i] ^= masking_key[i&0x3];
+            // Masking has to write somewhere, so a masked payload is copied
+            // exactly once, straight into the queue:
+            size_t message_offset = txbuf.size();
+            txbuf.resize(message_offset + message_size);
+            if (message_size) { websocketmask::mask(&txbuf[message_offset], message, (size_t)message_size, masking_key); }
+        }
+        else if (owner ? message_size < minReferencedPayload : message_size < minImmediatePayload) {
+            txbuf.insert(txbuf.end(), message, message + message_size);
+        }
+        else {
+            txref ref = { txbuf.size(), owner, message, (size_t) message_size };
+            txrefs.push_back(ref);
+            if (!owner) {
+                // Borrowed: write what the socket takes right now and copy
+                // only the unsent rest.
+                flushTx();
+                if (!txrefs.empty() && !txrefs.back().owner && txrefs.back().offset == txbuf.size()) {
+                    txbuf.insert(txbuf.end(), txrefs.back().data, txrefs.back().data + txrefs.back().size);
+                    txrefs.pop_back();
+                }
             }
         }
+        wantWrite();
     }
 
     void close() {
         if(readyState == CLOSING || readyState == CLOSED) { return; }
         readyState = CLOSING;
         uint8_t closeFrame[6] = {0x88, 0x80, 0x00, 0x00, 0x00, 0x00}; // last 4 bytes are a masking key
-        std::vector<uint8_t> header(closeFrame, closeFrame+6);
-        txbuf.insert(txbuf.end(), header.begin(), header.end());
+        if (useMask) { maskingKeys.next(closeFrame + 2); }
+        txbuf.insert(txbuf.end(), closeFrame, closeFrame+6);
+        wantWrite();
+    }
+
+    void wantWrite() {
+        if (writeQueue && !queuedForWrite) {
+            queuedForWrite = true;
+            writeQueue->push_back(this);
+        }
+    }
+
+};
+
+
+#if defined(EASYWSCLIENT_EPOLL) || defined(EASYWSCLIENT_KQUEUE)
+
+class _RealReactor : public easywsclient::Reactor
+{
+  public:
+    std::vector<_RealWebSocket *> sockets;
+    std::vector<_RealWebSocket *> writeQueue; // sockets with frames queued since they were last polled
+    std::vector<_RealWebSocket *> readyList;  // sockets polled since the last dispatch
+    int pollfd;
+
+#ifdef EASYWSCLIENT_EPOLL
+    _RealReactor() : pollfd(epoll_create1(EPOLL_CLOEXEC)) { }
+#else
+    _RealReactor() : pollfd(kqueue()) { }
+#endif
+
+    ~_RealReactor() {
+        // Leave the sockets usable on their own:
+        for (size_t i = 0; i != writeQueue.size(); ++i) { writeQueue[i]->queuedForWrite = false; }
+        for (size_t i = 0; i != readyList.size(); ++i) { readyList[i]->queuedForDispatch = false; }
+        detachAll();
+        if (pollfd >= 0) { ::close(pollfd); }
+    }
+
+    void detachAll() {
+        for (size_t i = 0; i != sockets.size(); ++i) { sockets[i]->writeQueue = NULL; }
+        sockets.clear();
+    }
+
+    bool add(easywsclient::WebSocket::pointer ws) {
+        _RealWebSocket * real = dynamic_cast<_RealWebSocket *>(ws);
+        if (pollfd < 0 || real == NULL || real->writeQueue != NULL || real->getReadyState() == easywsclient::WebSocket::CLOSED) { return false; }
+#ifdef EASYWSCLIENT_EPOLL
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = real;
+        if (epoll_ctl(pollfd, EPOLL_CTL_ADD, real->sockfd, &ev) != 0) { return false; }
+#else
+        struct kevent changes[2];
+        EV_SET(&changes[0], real->sockfd, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, real);
+        EV_SET(&changes[1], real->sockfd, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, real);
+        if (kevent(pollfd, changes, 2, NULL, 0, NULL) != 0) { return false; }
+#endif
+        real->writeQueue = &writeQueue;
+        sockets.push_back(real);
+        // Whatever arrived or was queued before registering produces no edge:
+        real->wantWrite();
+        return true;
+    }
+
+    void remove(easywsclient::WebSocket::pointer ws) {
+        _RealWebSocket * real = dynamic_cast<_RealWebSocket *>(ws);
+        if (real == NULL || real->writeQueue != &writeQueue) { return; }
+        if (real->getReadyState() != easywsclient::WebSocket::CLOSED) {
+#ifdef EASYWSCLIENT_EPOLL
+            epoll_ctl(pollfd, EPOLL_CTL_DEL, real->sockfd, NULL);
+#else
+            struct kevent changes[2];
+            EV_SET(&changes[0], real->sockfd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+            EV_SET(&changes[1], real->sockfd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+            kevent(pollfd, changes, 2, NULL, 0, NULL);
+#endif
+        }
+        erase(sockets, real);
+        erase(writeQueue, real);
+        erase(readyList, real);
+        real->writeQueue = NULL;
+        real->queuedForWrite = false;
+        real->queuedForDispatch = false;
+    }
+
+    static void erase(std::vector<_RealWebSocket *>& list, _RealWebSocket * real) {
+        for (size_t i = 0; i != list.size(); ++i) {
+            if (list[i] == real) { list[i] = list.back(); list.pop_back(); return; }
+        }
+    }
+
+    void service(_RealWebSocket * real, bool hungUp) {
+        // Reads until the socket is drained and writes until EAGAIN. A short read
+        // counts as drained, but once the peer has shut down the FIN came with
+        // this edge and won't bring another, so read on until recv returns 0:
+        real->poll(0);
+        while (hungUp && real->getReadyState() != easywsclient::WebSocket::CLOSED) { real->poll(0); }
+        if (!real->queuedForDispatch) {
+            real->queuedForDispatch = true;
+            readyList.push_back(real);
+        }
+    }
+
+    int poll(int timeout) {
+        if (pollfd < 0) { return 0; }
+        size_t serviced = readyList.size();
+        // Flush what was sent since the last poll; whatever doesn't fit comes back as a write edge:
+        std::vector<_RealWebSocket *> queued;
+        queued.swap(writeQueue);
+        for (size_t i = 0; i != queued.size(); ++i) {
+            queued[i]->queuedForWrite = false;
+            service(queued[i], false);
+        }
+        if (!queued.empty()) { timeout = 0; }
+        const int maxEvents = 64;
+#ifdef EASYWSCLIENT_EPOLL
+        epoll_event events[maxEvents];
+        int n = epoll_wait(pollfd, events, maxEvents, timeout);
+        for (int i = 0; i < n; ++i) { service((_RealWebSocket *) events[i].data.ptr, (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0); }
+#else
+        struct kevent events[maxEvents];
+        timespec ts = { timeout/1000, (timeout%1000) * 1000000 };
+        int n = kevent(pollfd, NULL, 0, events, maxEvents, timeout >= 0 ? &ts : NULL);
+        for (int i = 0; i < n; ++i) { service((_RealWebSocket *) events[i].udata, events[i].filter == EVFILT_READ && (events[i].flags & EV_EOF) != 0); }
+#endif
+        return (int) (readyList.size() - serviced);
     }
 
+    void _dispatch(easywsclient::ReactorCallback_Imp& callable) {
+        struct CallbackAdapter : public BytesCallback_Imp
+        {
+            easywsclient::ReactorCallback_Imp& callable;
+            easywsclient::WebSocket& ws;
+            CallbackAdapter(easywsclient::ReactorCallback_Imp& callable, easywsclient::WebSocket& ws) : callable(callable), ws(ws) { }
+            void operator()(const std::vector<uint8_t>& message) {
+                std::string stringMessage(message.begin(), message.end());
+                callable(ws, stringMessage);
+            }
+        };
+        // A callback may send, queueing more work for the next poll, but not add or remove sockets:
+        std::vector<_RealWebSocket *> ready;
+        ready.swap(readyList);
+        for (size_t i = 0; i != ready.size(); ++i) {
+            ready[i]->queuedForDispatch = false;
+            CallbackAdapter bytesCallback(callable, *ready[i]);
+            ready[i]->_dispatchBinary(bytesCallback);
+        }
+    }
 };
 
+#endif
+
 
 easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask, const std::string& origin) {
     char host[512];
@@ -482,6 +948,11 @@ easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask,
         fprintf(stderr, "ERROR: Could not parse WebSocket url: %s\n", url.c_str());
         return NULL;
     }
+    _MaskingKeys maskingKeys;
+    if (useMask && !maskingKeys.seed()) {
+        fprintf(stderr, "ERROR: Could not seed masking keys for: %s\n", url.c_str());
+        return NULL;
+    }
     //fprintf(stderr, "easywsclient: connecting: host=%s port=%d path=/%s\n", host, port, path);
     socket_t sockfd = hostname_connect(host, port);
     if (sockfd == INVALID_SOCKET) {
@@ -527,7 +998,7 @@ easywsclient::WebSocket::pointer from_url(const std::string& url, bool useMask,
     fcntl(sockfd, F_SETFL, O_NONBLOCK);
 #endif
     //fprintf(stderr, "Connected to: %s\n", url.c_str());
-    return easywsclient::WebSocket::pointer(new _RealWebSocket(sockfd, useMask));
+    return easywsclient::WebSocket::pointer(new _RealWebSocket(sockfd, useMask, maskingKeys));
 }
 
 } // end of module-only namespace
@@ -550,5 +1021,18 @@ WebSocket::pointer WebSocket::from_url_no_mask(const std::string& url, const std
     return ::from_url(url, false, origin);
 }
 
+Reactor::pointer Reactor::create() {
+#if defined(EASYWSCLIENT_EPOLL) || defined(EASYWSCLIENT_KQUEUE)
+    _RealReactor * reactor = new _RealReactor;
+    if (reactor->pollfd < 0) {
+        delete reactor;
+        return NULL;
+    }
+    return reactor;
+#else
+    return NULL;
+#endif
+}
+
 
 } // namespace easywsclient
@@ -10,12 +10,23 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <stdint.h>
 
 namespace easywsclient {
 
 struct Callback_Imp { virtual void operator()(const std::string& message) = 0; };
 struct BytesCallback_Imp { virtual void operator()(const std::vector<uint8_t>& message) = 0; };
 
+// Per-connection transport counters, bytesReceived / recvCalls is the average
+// read size. Every read or write syscall counts, including ones that hit EAGAIN.
+struct TransportStats {
+    uint64_t bytesReceived;
+    uint64_t recvCalls;
+    uint64_t bytesSent;
+    uint64_t sendCalls;
+};
+
 class WebSocket {
   public:
     typedef WebSocket * pointer;
@@ -32,9 +43,15 @@ class WebSocket {
     virtual void send(const std::string& message) = 0;
     virtual void sendBinary(const std::string& message) = 0;
     virtual void sendBinary(const std::vector<uint8_t>& message) = 0;
+    // Without copying the payload: an unmasked socket writes it straight from
+    // the shared buffer and keeps the reference until it is out, a masked one
+    // masks it directly into the send queue.
+    virtual void send(const std::shared_ptr<const std::string>& message) { send(*message); }
+    virtual void sendBinary(const std::shared_ptr<const std::vector<uint8_t> >& message) { sendBinary(*message); }
     virtual void sendPing() = 0;
     virtual void close() = 0;
     virtual readyStateValues getReadyState() const = 0;
+    virtual TransportStats getStats() const { TransportStats none = { 0, 0, 0, 0 }; return none; }
 
     template<class Callable>
     void dispatch(Callable callable)
@@ -67,6 +84,42 @@ class WebSocket {
     virtual void _dispatchBinary(BytesCallback_Imp& callable) = 0;
 };
 
+struct ReactorCallback_Imp { virtual void operator()(WebSocket& ws, const std::string& message) = 0; };
+
+// Drives many WebSockets from one thread. Sockets are registered edge-triggered
+// (epoll on Linux, kqueue on macOS/BSD) and a poll() only touches the ones that
+// became ready, instead of one select() per socket. The reactor doesn't own the
+// sockets: remove() a socket before deleting it.
+class Reactor {
+  public:
+    typedef Reactor * pointer;
+
+    // Factory, returns NULL where neither epoll nor kqueue is available:
+    static pointer create();
+
+    virtual ~Reactor() { }
+    virtual bool add(WebSocket::pointer ws) = 0; // false for dummies and closed sockets
+    virtual void remove(WebSocket::pointer ws) = 0;
+    virtual int poll(int timeout = 0) = 0; // timeout in milliseconds, -1 blocks; returns how many sockets had work
+
+    template<class Callable>
+    void dispatch(Callable callable)
+        // Calls callable(WebSocket&, const std::string&) for every message
+        // received by the sockets that were ready since the last dispatch.
+    {
+        struct _Callback : public ReactorCallback_Imp {
+            Callable& callable;
+            _Callback(Callable& callable) : callable(callable) { }
+            void operator()(WebSocket& ws, const std::string& message) { callable(ws, message); }
+        };
+        _Callback callback(callable);
+        _dispatch(callback);
+    }
+
+  protected:
+    virtual void _dispatch(ReactorCallback_Imp& callable) = 0;
+};
+
 } // namespace easywsclient
 
 #endif /* EASYWSCLIENT_HPP_20120819_MIOFVASDTNUASZDQPLFD */
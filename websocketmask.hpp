@@ -0,0 +1,145 @@
+//
+//  websocketmask.hpp
+//
+//  RFC 6455 5.3 payload masking, shared by the Beast transport in ObsMessageHandler and by easywsclient.
+//  Header only so neither side has to link the other.
+//
+
+#ifndef WEBSOCKETMASK_HPP
+#define WEBSOCKETMASK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define WEBSOCKETMASK_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WEBSOCKETMASK_NEON 1
+#endif
+
+namespace websocketmask
+{
+    //the key from byte _phase on, repeated over a 64 bit word in memory order
+    inline uint64_t repeatKey(const uint8_t* _key, std::size_t _phase)
+    {
+        uint8_t bytes[8];
+        for(std::size_t i = 0; i < 8; i++) bytes[i] = _key[(_phase + i) & 3];
+
+        uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        return word;
+    }
+
+    //the kernels below mask whole blocks and return how many bytes they did, every block size is a multiple
+    //of 8 so the key word stays in phase; each block is loaded before it is stored, so _dst may trail _src
+    inline std::size_t maskWords(uint8_t* _dst, const uint8_t* _src, std::size_t _size, uint64_t _key)
+    {
+        std::size_t i = 0;
+        for(; i + 8 <= _size; i += 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, _src + i, 8);
+            word ^= _key;
+            std::memcpy(_dst + i, &word, 8);
+        }
+
+        return i;
+    }
+
+#if WEBSOCKETMASK_X86
+    inline std::size_t maskSse2(uint8_t* _dst, const uint8_t* _src, std::size_t _size, uint64_t _key)
+    {
+        const __m128i key = _mm_set1_epi64x(static_cast<long long>(_key));
+        std::size_t i = 0;
+        for(; i + 32 <= _size; i += 32)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i + 16));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i), _mm_xor_si128(a, key));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i + 16), _mm_xor_si128(b, key));
+        }
+        for(; i + 16 <= _size; i += 16)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_dst + i), _mm_xor_si128(a, key));
+        }
+
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    inline std::size_t maskAvx2(uint8_t* _dst, const uint8_t* _src, std::size_t _size, uint64_t _key)
+    {
+        const __m256i key = _mm256_set1_epi64x(static_cast<long long>(_key));
+        std::size_t i = 0;
+        for(; i + 64 <= _size; i += 64)
+        {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_src + i));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_src + i + 32));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(_dst + i), _mm256_xor_si256(a, key));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(_dst + i + 32), _mm256_xor_si256(b, key));
+        }
+
+        return i;
+    }
+
+    inline bool hasAvx2()
+    {
+        //may run from a static initializer, before the cpu model is set up
+        static const bool supported = []
+        {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+        }();
+        return supported;
+    }
+#elif WEBSOCKETMASK_NEON
+    inline std::size_t maskNeon(uint8_t* _dst, const uint8_t* _src, std::size_t _size, uint64_t _key)
+    {
+        const uint8x16_t key = vreinterpretq_u8_u64(vdupq_n_u64(_key));
+        std::size_t i = 0;
+        for(; i + 32 <= _size; i += 32)
+        {
+            const uint8x16_t a = vld1q_u8(_src + i);
+            const uint8x16_t b = vld1q_u8(_src + i + 16);
+            vst1q_u8(_dst + i, veorq_u8(a, key));
+            vst1q_u8(_dst + i + 16, veorq_u8(b, key));
+        }
+        for(; i + 16 <= _size; i += 16) vst1q_u8(_dst + i, veorq_u8(vld1q_u8(_src + i), key));
+
+        return i;
+    }
+#endif
+
+    //_dst[i] = _src[i] ^ _key[i & 3] for any alignment; _dst may be _src, or lie before it when a payload
+    //is masked while it slides towards its header
+    inline void mask(uint8_t* _dst, const uint8_t* _src, std::size_t _size, const uint8_t* _key)
+    {
+        //bytes up to the first aligned word of _dst, the rest of the key is rotated to continue from there
+        std::size_t head = (8 - (reinterpret_cast<uintptr_t>(_dst) & 7)) & 7;
+        if(head > _size) head = _size;
+        for(std::size_t i = 0; i < head; i++) _dst[i] = _src[i] ^ _key[i & 3];
+        _dst += head;
+        _src += head;
+        _size -= head;
+
+        const uint64_t key = repeatKey(_key, head);
+        std::size_t done = 0;
+#if WEBSOCKETMASK_X86
+        if(_size >= 64 && hasAvx2()) done = maskAvx2(_dst, _src, _size, key);
+        done += maskSse2(_dst + done, _src + done, _size - done, key);
+#elif WEBSOCKETMASK_NEON
+        done = maskNeon(_dst, _src, _size, key);
+#endif
+        done += maskWords(_dst + done, _src + done, _size - done, key);
+
+        //less than a word left and done is a multiple of 8, so the tail starts at the first key byte again
+        const uint8_t* keyBytes = reinterpret_cast<const uint8_t*>(&key);
+        for(std::size_t i = 0; done + i < _size; i++) _dst[done + i] = _src[done + i] ^ keyBytes[i];
+    }
+}
+
+#endif